@@ -0,0 +1,158 @@
+// Micro-benchmark that measures the burdens of the burdened-span model
+// of cilkprof on the current host, in cycles.  It prints the burdens as
+// shell assignments of the environment variables that cilkprof reads:
+//
+//   CILKPROF_SPAWN_BURDEN   overhead of a spawn, measured serially
+//   CILKPROF_CONTIN_BURDEN  latency of stealing the continuation of a spawn
+//   CILKPROF_SYNC_BURDEN    latency of resuming a stolen continuation at a
+//                           sync, once its last child returns
+//
+// Each burden is the median over many trials.
+
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static const int SPAWN_ITERATIONS = 1000000;
+static const int STEAL_TRIALS = 1001;
+
+// Give up on a steal after this many cycles
+static const uint64_t STEAL_TIMEOUT = 100000000;
+// Time the child of a stolen spawn keeps running, so that the
+// continuation reaches the sync first
+static const uint64_t SYNC_DELAY = 200000;
+
+static inline uint64_t rdtsc(void) {
+  unsigned hi, lo;
+  __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+  return (uint64_t)lo + (((uint64_t)hi) << 32);
+}
+
+static int compare_uint64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+static uint64_t median(uint64_t *samples, int n) {
+  qsort(samples, n, sizeof(uint64_t), compare_uint64);
+  return samples[n / 2];
+}
+
+static void set_nworkers(const char *nworkers) {
+  __cilkrts_end_cilk();
+  if (0 != __cilkrts_set_param("nworkers", nworkers)) {
+    fprintf(stderr, "burden_calibrate: cannot set nworkers to %s\n", nworkers);
+    exit(1);
+  }
+}
+
+__attribute__((noinline)) static void noop(void) {
+  __asm__ __volatile__ ("");
+}
+
+// Cycles per iteration of a loop that calls noop
+__attribute__((noinline)) static uint64_t time_calls(void) {
+  uint64_t start = rdtsc();
+  for (int i = 0; i < SPAWN_ITERATIONS; ++i) {
+    noop();
+  }
+  return (rdtsc() - start) / SPAWN_ITERATIONS;
+}
+
+// Cycles per iteration of a loop that spawns noop
+__attribute__((noinline)) static uint64_t time_spawns(void) {
+  uint64_t start = rdtsc();
+  for (int i = 0; i < SPAWN_ITERATIONS; ++i) {
+    cilk_spawn noop();
+  }
+  cilk_sync;
+  return (rdtsc() - start) / SPAWN_ITERATIONS;
+}
+
+// Measure the spawn burden on a single worker, where no steals occur.
+static uint64_t measure_spawn_burden(void) {
+  uint64_t samples[11];
+  for (int i = 0; i < 11; ++i) {
+    uint64_t call = time_calls();
+    uint64_t spawn = time_spawns();
+    samples[i] = (spawn > call) ? spawn - call : 0;
+  }
+  return median(samples, 11);
+}
+
+// State shared between the child and the continuation of a trial
+static volatile uint64_t spawn_time;
+static volatile uint64_t steal_time;
+static volatile uint64_t child_end_time;
+static volatile int child_worker;
+static volatile int stolen;
+
+__attribute__((noinline)) static void spin_until_stolen(void) {
+  child_worker = __cilkrts_get_worker_number();
+  while (!stolen && rdtsc() - spawn_time < STEAL_TIMEOUT)
+    ;
+  // Let the continuation reach the sync before returning.
+  uint64_t start = rdtsc();
+  while (rdtsc() - start < SYNC_DELAY)
+    ;
+  child_end_time = rdtsc();
+}
+
+// Run one trial of a spawn whose continuation is stolen.  Returns 1 and
+// sets the steal and sync latencies if the continuation was stolen,
+// and returns 0 otherwise.
+__attribute__((noinline)) static int steal_trial(uint64_t *steal, uint64_t *sync) {
+  stolen = 0;
+  spawn_time = rdtsc();
+  cilk_spawn spin_until_stolen();
+  steal_time = rdtsc();
+  stolen = 1;
+  int contin_worker = __cilkrts_get_worker_number();
+  cilk_sync;
+  uint64_t resume_time = rdtsc();
+
+  if (contin_worker == child_worker || steal_time < spawn_time ||
+      resume_time < child_end_time)
+    return 0;
+  *steal = steal_time - spawn_time;
+  *sync = resume_time - child_end_time;
+  return 1;
+}
+
+// Measure the continuation and sync burdens on two workers.
+static void measure_steal_burdens(uint64_t *contin_burden, uint64_t *sync_burden) {
+  uint64_t *steals = (uint64_t*)malloc(sizeof(uint64_t) * STEAL_TRIALS);
+  uint64_t *syncs = (uint64_t*)malloc(sizeof(uint64_t) * STEAL_TRIALS);
+  int n = 0;
+  for (int i = 0; i < STEAL_TRIALS; ++i) {
+    n += steal_trial(&steals[n], &syncs[n]);
+  }
+  if (0 == n) {
+    fprintf(stderr, "burden_calibrate: no steals observed\n");
+    *contin_burden = 0;
+    *sync_burden = 0;
+  } else {
+    *contin_burden = median(steals, n);
+    *sync_burden = median(syncs, n);
+  }
+  free(steals);
+  free(syncs);
+}
+
+int main(int argc, char *argv[]) {
+  set_nworkers("1");
+  uint64_t spawn_burden = measure_spawn_burden();
+
+  uint64_t contin_burden, sync_burden;
+  set_nworkers("2");
+  measure_steal_burdens(&contin_burden, &sync_burden);
+
+  printf("export CILKPROF_SPAWN_BURDEN=%lu\n", spawn_burden);
+  printf("export CILKPROF_CONTIN_BURDEN=%lu\n", contin_burden);
+  printf("export CILKPROF_SYNC_BURDEN=%lu\n", sync_burden);
+  return 0;
+}
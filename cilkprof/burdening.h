@@ -0,0 +1,29 @@
+#ifndef INCLUDED_BURDENING_H
+#define INCLUDED_BURDENING_H
+
+// Set BURDENED_SPAN to 1 to compute, alongside the span, the burdened
+// span of the computation and of every call site.  The burdened span
+// charges the scheduling overheads of the runtime system to the dag:
+// every spawned child is burdened with the cost of a spawn, every
+// continuation of a spawn with the cost of a steal, and every sync of
+// spawned children with the cost of a sync.  The burdens are read at
+// startup from the environment variables CILKPROF_SPAWN_BURDEN,
+// CILKPROF_CONTIN_BURDEN and CILKPROF_SYNC_BURDEN, in the units of the
+// strand ruler, and can be measured on the current host with
+// burden_calibrate.
+#ifndef BURDENED_SPAN
+#define BURDENED_SPAN 1
+#endif
+
+// Default value of each burden, when it is not set in the environment
+#ifndef BURDENING
+#define BURDENING 0
+#endif
+
+#if BURDENED_SPAN
+#define WHEN_BURDENED_SPAN(ex) do { ex } while (0)
+#else
+#define WHEN_BURDENED_SPAN(ex) do {} while (0)
+#endif
+
+#endif
@@ -2,6 +2,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 #include <assert.h>
 
@@ -11,57 +12,112 @@
 // Starting capacity of the hash table is 2^2 entries.
 /* static */ const int START_CC_LG_CAPACITY = 2;
 
-// Threshold fraction of table size that can be in the linked list.
+// Threshold fraction of table size that can be in the log.
 /* static */ const int TABLE_CONSTANT = 4;
 
+// Starting capacity of the log, allocated on first use.
+/* static */ const int START_CC_LOG_CAPACITY = 8;
+
 /* int MIN_LG_CAPACITY = START_CC_LG_CAPACITY; */
 int MIN_CAPACITY = 1;
 
-cc_hashtable_list_el_t *ll_free_list = NULL;
+// Tables that are freed or outgrown are kept in a pool, indexed by lg
+// of capacity, and reused before allocating new ones.  Each worker has
+// its own pool, so the parallel tool needs no locking.
+#define CC_POOL_LEVELS 32
+#if SERIAL_TOOL
+static cc_hashtable_t *cc_table_pool[CC_POOL_LEVELS];
+#else
+static __thread cc_hashtable_t *cc_table_pool[CC_POOL_LEVELS];
+#endif
 
-// Return true if this entry is empty, false otherwise.
-bool empty_cc_entry_p(const cc_hashtable_entry_t *entry) {
-  return (0 == entry->initialized);
+// Return true if this entry of tab is empty, false otherwise.
+bool empty_cc_entry_p(const cc_hashtable_t *tab,
+                      const cc_hashtable_entry_t *entry) {
+  return (tab->epoch != entry->epoch);
 }
 
 
-// Create an empty hashtable entry
+// Create an empty hashtable entry.  Tables never use epoch 0.
 static void make_empty_cc_entry(cc_hashtable_entry_t *entry) {
-  entry->initialized = 0;
+  entry->epoch = 0;
 }
 
 
-// Allocate an empty hash table with 2^lg_capacity entries
-static cc_hashtable_t* cc_hashtable_alloc(int lg_capacity) {
+// Return the lg of the smallest power of 2 that is at least x.
+static inline int ceil_lg(uint32_t x) {
+  return (x <= 1) ? 0 : 32 - __builtin_clz(x - 1);
+}
+
+// Allocate an empty hash table with 2^lg_capacity entries, whose
+// indices are bounded by *min_capacity.  The entries of the table are
+// not initialized.
+static cc_hashtable_t* cc_hashtable_alloc(int lg_capacity,
+                                          const int *min_capacity) {
   assert(lg_capacity >= START_CC_LG_CAPACITY);
   size_t capacity = 1 << lg_capacity;
   cc_hashtable_t *table =
     (cc_hashtable_t*)malloc(sizeof(cc_hashtable_t)
-			    + (capacity * sizeof(cc_hashtable_entry_t)));
-
-  int *populated_entries = (int*)malloc(sizeof(int) * capacity);
+			    + (capacity * sizeof(cc_hashtable_entry_t))
+                            + (capacity * sizeof(int)));
 
   table->lg_capacity = lg_capacity;
-  table->list_size = 0;
+  table->log_size = 0;
+  table->log_capacity = 0;
   table->table_size = 0;
-  table->head = NULL;
-  table->tail = NULL;
-  table->populated = populated_entries;
+  table->epoch = 1;
+  table->min_capacity = min_capacity;
+  table->log = NULL;
+  table->populated = (int*)&(table->entries[capacity]);
+  table->next_free = NULL;
 
   return table;
 }
 
+// Take a table with between 2^lo and 2^hi entries out of the pool,
+// preferring the largest.  Returns NULL if there is none.  The table
+// keeps its log storage, and it has no valid entries.
+static cc_hashtable_t* cc_hashtable_reuse(int lo, int hi,
+                                          const int *min_capacity) {
+  if (hi >= CC_POOL_LEVELS)
+    hi = CC_POOL_LEVELS - 1;
+  for (int lg = hi; lg >= lo; --lg) {
+    cc_hashtable_t *table = cc_table_pool[lg];
+    if (NULL != table) {
+      cc_table_pool[lg] = table->next_free;
+      table->next_free = NULL;
+      table->min_capacity = min_capacity;
+      assert(cc_hashtable_is_empty(table));
+      return table;
+    }
+  }
+  return NULL;
+}
 
-// Create a new, empty hashtable.  Returns a pointer to the hashtable
-// created.
-cc_hashtable_t* cc_hashtable_create(void) {
-  cc_hashtable_t *tab = cc_hashtable_alloc(START_CC_LG_CAPACITY);
+// Create a new, empty hashtable whose indices are less than
+// *min_capacity.  Returns a pointer to the hashtable created.
+cc_hashtable_t* cc_hashtable_create_bounded(const int *min_capacity) {
+  // A pooled table is reused if it is no larger than a table would
+  // need to be to hold every index seen so far.
+  int lg_capacity = ceil_lg(*min_capacity);
+  cc_hashtable_t *tab = cc_hashtable_reuse(START_CC_LG_CAPACITY, lg_capacity,
+                                           min_capacity);
+  if (NULL != tab)
+    return tab;
+
+  tab = cc_hashtable_alloc(START_CC_LG_CAPACITY, min_capacity);
   for (size_t i = 0; i < (1 << START_CC_LG_CAPACITY); ++i) {
     make_empty_cc_entry(&(tab->entries[i]));
   }
   return tab;
 }
 
+// Create a new, empty hashtable indexed by call site.  Returns a
+// pointer to the hashtable created.
+cc_hashtable_t* cc_hashtable_create(void) {
+  return cc_hashtable_create_bounded(&MIN_CAPACITY);
+}
+
 #ifndef NDEBUG
 static inline
 int can_override_entry(cc_hashtable_entry_t *entry, uintptr_t new_rip) {
@@ -83,21 +139,70 @@ void combine_entries(cc_hashtable_entry_t *entry,
   entry->top_wrk += entry_add->top_wrk;
   entry->top_spn += entry_add->top_spn;
   entry->top_count += entry_add->top_count;
+#if BURDENED_SPAN
+  entry->bspn += entry_add->bspn;
+  entry->top_bspn += entry_add->top_bspn;
+#endif
+#if STRAND_PERF
+  add_strand_counters(&(entry->local_wrk_ctr), &(entry_add->local_wrk_ctr));
+  add_strand_counters(&(entry->local_spn_ctr), &(entry_add->local_spn_ctr));
+  add_strand_counters(&(entry->wrk_ctr), &(entry_add->wrk_ctr));
+  add_strand_counters(&(entry->spn_ctr), &(entry_add->spn_ctr));
+  add_strand_counters(&(entry->top_wrk_ctr), &(entry_add->top_wrk_ctr));
+  add_strand_counters(&(entry->top_spn_ctr), &(entry_add->top_spn_ctr));
+#endif
 }
 
+#if STRAND_PERF
+static const strand_counters_t zero_counters = { { 0 } };
 
-// Return a hashtable with the contents of tab and more capacity.
-static cc_hashtable_t* increase_cc_table_capacity(const cc_hashtable_t *tab) {
+// Initialize the hardware-counter fields of entry
+static inline
+void set_entry_counters(cc_hashtable_entry_t *entry, bool is_top_fn,
+                        const strand_counters_t *wrk_ctr,
+                        const strand_counters_t *spn_ctr,
+                        const strand_counters_t *local_wrk_ctr,
+                        const strand_counters_t *local_spn_ctr) {
+  entry->wrk_ctr = *wrk_ctr;
+  entry->spn_ctr = *spn_ctr;
+  if (is_top_fn) {
+    entry->top_wrk_ctr = *wrk_ctr;
+    entry->top_spn_ctr = *spn_ctr;
+  } else {
+    clear_strand_counters(&(entry->top_wrk_ctr));
+    clear_strand_counters(&(entry->top_spn_ctr));
+  }
+  entry->local_wrk_ctr = *local_wrk_ctr;
+  entry->local_spn_ctr = *local_spn_ctr;
+}
+
+// Accumulate into the hardware-counter fields of entry
+static inline
+void add_entry_counters(cc_hashtable_entry_t *entry, bool is_top_fn,
+                        const strand_counters_t *wrk_ctr,
+                        const strand_counters_t *spn_ctr,
+                        const strand_counters_t *local_wrk_ctr,
+                        const strand_counters_t *local_spn_ctr) {
+  add_strand_counters(&(entry->wrk_ctr), wrk_ctr);
+  add_strand_counters(&(entry->spn_ctr), spn_ctr);
+  if (is_top_fn) {
+    add_strand_counters(&(entry->top_wrk_ctr), wrk_ctr);
+    add_strand_counters(&(entry->top_spn_ctr), spn_ctr);
+  }
+  add_strand_counters(&(entry->local_wrk_ctr), local_wrk_ctr);
+  add_strand_counters(&(entry->local_spn_ctr), local_spn_ctr);
+}
+#endif
+
+
+// Return a hashtable with the contents of tab and more capacity.  The
+// log of tab moves to the new table.
+static cc_hashtable_t* increase_cc_table_capacity(cc_hashtable_t *tab) {
 
   int new_lg_capacity;
-  if ((1 << tab->lg_capacity) < MIN_CAPACITY) {
-    uint32_t x = MIN_CAPACITY - 1;
-    x |= x >> 1;
-    x |= x >> 2;
-    x |= x >> 4;
-    x |= x >> 8;
-    x |= x >> 16;
-    new_lg_capacity = __builtin_ctz(x + 1);
+  int min_capacity = *(tab->min_capacity);
+  if ((1 << tab->lg_capacity) < min_capacity) {
+    new_lg_capacity = ceil_lg(min_capacity);
   } else {
 #ifndef NDEBUG
     fprintf(stderr, "this should not be reachable\n");
@@ -108,7 +213,10 @@ static cc_hashtable_t* increase_cc_table_capacity(const cc_hashtable_t *tab) {
 
   /* fprintf(stderr, "resizing table\n"); */
 
-  new_tab = cc_hashtable_alloc(new_lg_capacity);
+  new_tab = cc_hashtable_reuse(new_lg_capacity, CC_POOL_LEVELS - 1,
+                              tab->min_capacity);
+  if (NULL == new_tab)
+    new_tab = cc_hashtable_alloc(new_lg_capacity, tab->min_capacity);
   size_t i = 0;
 
   for (i = 0; i < (1 << tab->lg_capacity); ++i) {
@@ -124,30 +232,57 @@ static cc_hashtable_t* increase_cc_table_capacity(const cc_hashtable_t *tab) {
   }
 
   new_tab->table_size = tab->table_size;
-
-  new_tab->list_size = tab->list_size;
-  new_tab->head = tab->head;
-  new_tab->tail = tab->tail;
+  new_tab->epoch = tab->epoch;
+
+  // Trade logs, so that tab keeps the spare log storage, if any, of a
+  // reused table.
+  cc_hashtable_log_el_t *spare_log = new_tab->log;
+  int spare_log_capacity = new_tab->log_capacity;
+  new_tab->log_size = tab->log_size;
+  new_tab->log_capacity = tab->log_capacity;
+  new_tab->log = tab->log;
+  tab->log_size = 0;
+  tab->log_capacity = spare_log_capacity;
+  tab->log = spare_log;
 
   return new_tab;
 }
 
 
+// Ensure the log of tab can hold at least min_capacity records.
+static void reserve_cc_log(cc_hashtable_t *tab, int min_capacity) {
+  if (min_capacity <= tab->log_capacity)
+    return;
+
+  int new_capacity = (0 == tab->log_capacity) ?
+    START_CC_LOG_CAPACITY : 2 * tab->log_capacity;
+  while (new_capacity < min_capacity)
+    new_capacity *= 2;
+
+  tab->log = (cc_hashtable_log_el_t*)realloc(tab->log,
+                                             sizeof(cc_hashtable_log_el_t)
+                                             * new_capacity);
+  assert(NULL != tab->log);
+  tab->log_capacity = new_capacity;
+}
+
+
+// Append a record to the log of tab, and return a pointer to it.
+static inline cc_hashtable_log_el_t* append_to_cc_log(cc_hashtable_t *tab) {
+  if (tab->log_size == tab->log_capacity)
+    reserve_cc_log(tab, tab->log_size + 1);
+  return &(tab->log[tab->log_size++]);
+}
+
+
 // Add entry to tab, resizing tab if necessary.  Returns a pointer to
 // the entry if it can find a place to store it, NULL otherwise.
 /* static */ __attribute__((always_inline)) cc_hashtable_entry_t*
 get_cc_hashtable_entry_at_index(uint32_t index, cc_hashtable_t **tab) {
   if (index >= (1 << (*tab)->lg_capacity)) {
     cc_hashtable_t *new_tab = increase_cc_table_capacity(*tab);
-
     assert(new_tab);
-    assert(new_tab->head == (*tab)->head);
-    assert(new_tab->tail == (*tab)->tail);
-    (*tab)->head = NULL;
-    (*tab)->tail = NULL;
-
-    free((*tab)->populated);
-    free(*tab);
+    free_cc_hashtable(*tab);
     *tab = new_tab;
   }
 
@@ -156,60 +291,43 @@ get_cc_hashtable_entry_at_index(uint32_t index, cc_hashtable_t **tab) {
 
 
 static inline
-void flush_cc_hashtable_list(cc_hashtable_t **tab) {
+void flush_cc_hashtable_log(cc_hashtable_t **tab) {
 
-  // Flush list into table
-  cc_hashtable_list_el_t *lst_entry = (*tab)->head;
-  int entries_added = 0;
+  // Flush log into table.  Resizing the table moves the log to the
+  // new table without reallocating it, so these stay valid.
+  const cc_hashtable_log_el_t *log = (*tab)->log;
+  const int log_size = (*tab)->log_size;
 
-  while (NULL != lst_entry) {
-    cc_hashtable_entry_t *entry = &(lst_entry->entry);
-
-    if (lst_entry == (*tab)->tail) {
-      assert(entries_added == (*tab)->list_size - 1);
-      assert(lst_entry->next == NULL);
-    }
+  for (int i = 0; i < log_size; ++i) {
+    const cc_hashtable_log_el_t *log_entry = &(log[i]);
+    const cc_hashtable_entry_t *entry = &(log_entry->entry);
 
     cc_hashtable_entry_t *tab_entry;
 
     /* tab_entry = get_cc_hashtable_entry(entry->rip, tab); */
-    tab_entry = get_cc_hashtable_entry_at_index(lst_entry->index, tab);
+    tab_entry = get_cc_hashtable_entry_at_index(log_entry->index, tab);
     assert(NULL != tab_entry);
-    assert(empty_cc_entry_p(tab_entry) || can_override_entry(tab_entry, entry->rip));
+    assert(empty_cc_entry_p(*tab, tab_entry) || can_override_entry(tab_entry, entry->rip));
 
-    if (empty_cc_entry_p(tab_entry)) {
+    if (empty_cc_entry_p(*tab, tab_entry)) {
       // the compiler will do a struct copy
       *tab_entry = *entry;
-      tab_entry->initialized = 1;
+      tab_entry->epoch = (*tab)->epoch;
       /* (*tab)->populated[(*tab)->table_size] = cc_index(entry->rip); */
-      (*tab)->populated[(*tab)->table_size] = lst_entry->index;
+      (*tab)->populated[(*tab)->table_size] = log_entry->index;
       ++(*tab)->table_size;
     } else {
       combine_entries(tab_entry, entry);
     }
-
-    entries_added++;
-    cc_hashtable_list_el_t *next_lst_entry = lst_entry->next;
-    // free(lst_entry);
-    lst_entry = next_lst_entry;
   }
 
-  if (NULL != (*tab)->head) {
-    assert(NULL != (*tab)->tail);
-    (*tab)->tail->next = ll_free_list;
-    ll_free_list = (*tab)->head;
-  }
-
-  (*tab)->head = NULL;
-  (*tab)->tail = NULL;
-  (*tab)->list_size = 0;
+  assert(log == (*tab)->log);
+  (*tab)->log_size = 0;
 }
 
 void flush_cc_hashtable(cc_hashtable_t **tab) {
-  if (NULL != (*tab)->head)
-    flush_cc_hashtable_list(tab);
-  else
-    assert((*tab)->list_size == 0);
+  if ((*tab)->log_size > 0)
+    flush_cc_hashtable_log(tab);
 }
 
 
@@ -223,80 +341,77 @@ bool add_to_cc_hashtable(cc_hashtable_t **tab,
                          uint32_t index,
 #ifndef NDEBUG
                          uintptr_t rip,
+#endif
+#if STRAND_PERF
+                         const strand_counters_t *wrk_ctr,
+                         const strand_counters_t *spn_ctr,
+                         const strand_counters_t *local_wrk_ctr,
+                         const strand_counters_t *local_spn_ctr,
+#endif
+#if BURDENED_SPAN
+                         uint64_t bspn,
 #endif
                          uint64_t wrk, uint64_t spn,
                          uint64_t local_wrk, uint64_t local_spn) {
   
   if (((0 == (*tab)->table_size) || (index >= (1 << (*tab)->lg_capacity))) &&
        /* (1 << (*tab)->lg_capacity) < MIN_CAPACITY && */
-      ((*tab)->list_size < MIN_CAPACITY * TABLE_CONSTANT)) {
+      ((*tab)->log_size < *((*tab)->min_capacity) * TABLE_CONSTANT)) {
     // If table does not reflect enough updates or new entry cannot be
     // placed in existing table and we're not ready to resize the
-    // table, add entry to linked list.
-    cc_hashtable_list_el_t *lst_entry;
-    if (NULL != ll_free_list) {
-      lst_entry = ll_free_list;
-      ll_free_list = ll_free_list->next;
-    } else {
-      lst_entry = (cc_hashtable_list_el_t*)malloc(sizeof(cc_hashtable_list_el_t));
-    }
+    // table, append entry to log.
+    cc_hashtable_log_el_t *log_entry = append_to_cc_log(*tab);
 
-    lst_entry->index = index;
+    log_entry->index = index;
 
-    /* lst_entry->entry.is_recursive = (0 != (RECURSIVE & inst_type)); */
+    /* log_entry->entry.is_recursive = (0 != (RECURSIVE & inst_type)); */
 #ifndef NDEBUG
-    lst_entry->entry.rip = rip;
+    log_entry->entry.rip = rip;
 #endif
-    lst_entry->entry.wrk = wrk;
-    lst_entry->entry.spn = spn;
-    lst_entry->entry.count = 1; /* (0 != (RECORD & inst_type)); */
+    log_entry->entry.wrk = wrk;
+    log_entry->entry.spn = spn;
+    log_entry->entry.count = 1; /* (0 != (RECORD & inst_type)); */
     /* if (TOP & inst_type) { */
     if (is_top_fn) {
-      lst_entry->entry.top_wrk = wrk;
-      lst_entry->entry.top_spn = spn;
+      log_entry->entry.top_wrk = wrk;
+      log_entry->entry.top_spn = spn;
       assert(0 != wrk);
-      lst_entry->entry.top_count = 1;
+      log_entry->entry.top_count = 1;
     } else {
-      lst_entry->entry.top_wrk = 0;
-      lst_entry->entry.top_spn = 0;
-      lst_entry->entry.top_count = 0;
+      log_entry->entry.top_wrk = 0;
+      log_entry->entry.top_spn = 0;
+      log_entry->entry.top_count = 0;
     }      
-    lst_entry->entry.local_wrk = local_wrk;
-    lst_entry->entry.local_spn = local_spn;
-    lst_entry->entry.local_count = 1;
-    lst_entry->next = NULL;
-
-    if (NULL == (*tab)->tail) {
-      (*tab)->tail = lst_entry;
-      assert(NULL == (*tab)->head);
-      (*tab)->head = lst_entry;
-    } else {
-      (*tab)->tail->next = lst_entry;
-      (*tab)->tail = lst_entry;
-    }
-
-    // Increment list size
-    ++(*tab)->list_size;
+    log_entry->entry.local_wrk = local_wrk;
+    log_entry->entry.local_spn = local_spn;
+    log_entry->entry.local_count = 1;
+#if BURDENED_SPAN
+    log_entry->entry.bspn = bspn;
+    log_entry->entry.top_bspn = is_top_fn ? bspn : 0;
+#endif
+#if STRAND_PERF
+    set_entry_counters(&(log_entry->entry), is_top_fn,
+                       wrk_ctr, spn_ctr, local_wrk_ctr, local_spn_ctr);
+#endif
 
   } else {
     
-    if ((*tab)->list_size > 0) {
-      assert((*tab)->head != NULL);
-      flush_cc_hashtable_list(tab);
+    if ((*tab)->log_size > 0) {
+      flush_cc_hashtable_log(tab);
     }
 
     // Otherwise, add it to the table directly
     /* cc_hashtable_entry_t *entry = get_cc_hashtable_entry(rip, tab); */
     cc_hashtable_entry_t *entry = get_cc_hashtable_entry_at_index(index, tab);
     assert(NULL != entry);
-    assert(empty_cc_entry_p(entry) || can_override_entry(entry, rip));
+    assert(empty_cc_entry_p(*tab, entry) || can_override_entry(entry, rip));
   
-    if (empty_cc_entry_p(entry)) {
+    if (empty_cc_entry_p(*tab, entry)) {
       /* entry->is_recursive = (0 != (RECURSIVE & inst_type)); */
 #ifndef NDEBUG
       entry->rip = rip;
 #endif
-      entry->initialized = 1;
+      entry->epoch = (*tab)->epoch;
       entry->wrk = wrk;
       entry->spn = spn;
       entry->count = 1; /* (0 != (RECORD & inst_type)); */
@@ -313,6 +428,14 @@ bool add_to_cc_hashtable(cc_hashtable_t **tab,
       entry->local_wrk = local_wrk;
       entry->local_spn = local_spn;
       entry->local_count = 1;
+#if BURDENED_SPAN
+      entry->bspn = bspn;
+      entry->top_bspn = is_top_fn ? bspn : 0;
+#endif
+#if STRAND_PERF
+      set_entry_counters(entry, is_top_fn,
+                         wrk_ctr, spn_ctr, local_wrk_ctr, local_spn_ctr);
+#endif
       /* (*tab)->populated[ (*tab)->table_size ] = cc_index(rip); */
       (*tab)->populated[ (*tab)->table_size ] = index;
       ++(*tab)->table_size;
@@ -329,6 +452,15 @@ bool add_to_cc_hashtable(cc_hashtable_t **tab,
         entry->top_spn += spn;
         entry->top_count += 1;
       }
+#if BURDENED_SPAN
+      entry->bspn += bspn;
+      if (is_top_fn)
+        entry->top_bspn += bspn;
+#endif
+#if STRAND_PERF
+      add_entry_counters(entry, is_top_fn,
+                         wrk_ctr, spn_ctr, local_wrk_ctr, local_spn_ctr);
+#endif
     }
   }
 
@@ -342,69 +474,62 @@ bool add_local_to_cc_hashtable(cc_hashtable_t **tab,
                                uint32_t index,
 #ifndef NDEBUG
                                uintptr_t rip,
+#endif
+#if STRAND_PERF
+                               const strand_counters_t *local_wrk_ctr,
+                               const strand_counters_t *local_spn_ctr,
 #endif
                                uint64_t local_wrk, uint64_t local_spn) {
 
   if (((0 == (*tab)->table_size) || (index >= (1 << (*tab)->lg_capacity))) &&
       /* (1 << (*tab)->lg_capacity) < MIN_CAPACITY && */
-      ((*tab)->list_size < MIN_CAPACITY * TABLE_CONSTANT)) {
+      ((*tab)->log_size < *((*tab)->min_capacity) * TABLE_CONSTANT)) {
     // If table does not reflect enough updates or new entry cannot be
     // placed in existing table and we're not ready to resize the
-    // table, add entry to linked list.
-    cc_hashtable_list_el_t *lst_entry;
-    if (NULL != ll_free_list) {
-      lst_entry = ll_free_list;
-      ll_free_list = ll_free_list->next;
-    } else {
-      lst_entry = (cc_hashtable_list_el_t*)malloc(sizeof(cc_hashtable_list_el_t));
-    }
+    // table, append entry to log.
+    cc_hashtable_log_el_t *log_entry = append_to_cc_log(*tab);
 
-    lst_entry->index = index;
+    log_entry->index = index;
 
 #ifndef NDEBUG
-    lst_entry->entry.rip = rip;
+    log_entry->entry.rip = rip;
+#endif
+    log_entry->entry.wrk = 0;
+    log_entry->entry.spn = 0;
+    log_entry->entry.count = 0;
+    log_entry->entry.top_wrk = 0;
+    log_entry->entry.top_spn = 0;
+    log_entry->entry.top_count = 0;
+    log_entry->entry.local_wrk = local_wrk;
+    log_entry->entry.local_spn = local_spn;
+    log_entry->entry.local_count = 1;
+#if BURDENED_SPAN
+    log_entry->entry.bspn = 0;
+    log_entry->entry.top_bspn = 0;
+#endif
+#if STRAND_PERF
+    set_entry_counters(&(log_entry->entry), false,
+                       &zero_counters, &zero_counters,
+                       local_wrk_ctr, local_spn_ctr);
 #endif
-    lst_entry->entry.wrk = 0;
-    lst_entry->entry.spn = 0;
-    lst_entry->entry.count = 0;
-    lst_entry->entry.top_wrk = 0;
-    lst_entry->entry.top_spn = 0;
-    lst_entry->entry.top_count = 0;
-    lst_entry->entry.local_wrk = local_wrk;
-    lst_entry->entry.local_spn = local_spn;
-    lst_entry->entry.local_count = 1;
-    lst_entry->next = NULL;
-
-    if (NULL == (*tab)->tail) {
-      (*tab)->tail = lst_entry;
-      assert(NULL == (*tab)->head);
-      (*tab)->head = lst_entry;
-    } else {
-      (*tab)->tail->next = lst_entry;
-      (*tab)->tail = lst_entry;
-    }
-
-    // Increment list size
-    ++(*tab)->list_size;
 
   } else {
     
-    if ((*tab)->list_size > 0) {
-      assert((*tab)->head != NULL);
-      flush_cc_hashtable_list(tab);
+    if ((*tab)->log_size > 0) {
+      flush_cc_hashtable_log(tab);
     }
 
     // Otherwise, add it to the table directly
     /* cc_hashtable_entry_t *entry = get_cc_hashtable_entry(rip, tab); */
     cc_hashtable_entry_t *entry = get_cc_hashtable_entry_at_index(index, tab);
     assert(NULL != entry);
-    assert(empty_cc_entry_p(entry) || can_override_entry(entry, rip));
+    assert(empty_cc_entry_p(*tab, entry) || can_override_entry(entry, rip));
   
-    if (empty_cc_entry_p(entry)) {
+    if (empty_cc_entry_p(*tab, entry)) {
 #ifndef NDEBUG
       entry->rip = rip;
 #endif
-      entry->initialized = 1;
+      entry->epoch = (*tab)->epoch;
       entry->wrk = 0;
       entry->spn = 0;
       entry->count = 0;
@@ -414,6 +539,14 @@ bool add_local_to_cc_hashtable(cc_hashtable_t **tab,
       entry->local_wrk = local_wrk;
       entry->local_spn = local_spn;
       entry->local_count = 1;
+#if BURDENED_SPAN
+      entry->bspn = 0;
+      entry->top_bspn = 0;
+#endif
+#if STRAND_PERF
+      set_entry_counters(entry, false, &zero_counters, &zero_counters,
+                         local_wrk_ctr, local_spn_ctr);
+#endif
       (*tab)->populated[ (*tab)->table_size ] = index;
       ++(*tab)->table_size;
     } else {
@@ -421,12 +554,45 @@ bool add_local_to_cc_hashtable(cc_hashtable_t **tab,
       entry->local_wrk += local_wrk;
       entry->local_spn += local_spn;
       entry->local_count += 1;
+#if STRAND_PERF
+      add_entry_counters(entry, false, &zero_counters, &zero_counters,
+                         local_wrk_ctr, local_spn_ctr);
+#endif
     }
   }
 
   return true;
 }
 
+// Combine the populated entries of *right into **left, ignoring the
+// log of *right.
+static inline void combine_cc_hashtable_entries(cc_hashtable_t **left,
+                                                const cc_hashtable_t *right) {
+  cc_hashtable_entry_t *l_entry;
+  const cc_hashtable_entry_t *r_entry;
+  for (size_t i = 0; i < right->table_size; ++i) {
+
+    r_entry = &(right->entries[ right->populated[i] ]);
+    assert(!empty_cc_entry_p(right, r_entry));
+
+    // *left may have less capacity than right.
+    l_entry = get_cc_hashtable_entry_at_index(right->populated[i], left);
+    assert(NULL != l_entry);
+    assert(empty_cc_entry_p(*left, l_entry) || can_override_entry(l_entry, r_entry->rip));
+
+    if (empty_cc_entry_p(*left, l_entry)) {
+      // let the compiler do the struct copy
+      *l_entry = *r_entry;
+      l_entry->epoch = (*left)->epoch;
+      (*left)->populated[ (*left)->table_size ] = right->populated[i];
+      ++(*left)->table_size;
+    } else {
+      combine_entries(l_entry, r_entry);
+    }
+
+  }
+}
+
 // Add the cc_hashtable **right into the cc_hashtable **left.  The
 // result will appear in **left, and **right might be modified in the
 // process.
@@ -435,107 +601,93 @@ cc_hashtable_t* add_cc_hashtables(cc_hashtable_t **left, cc_hashtable_t **right)
 
   /* fprintf(stderr, "add_cc_hashtables(%p, %p)\n", left, right); */
 
-  // Make sure that *left is at least as large as *right.
-  if ((*right)->lg_capacity > (*left)->lg_capacity) {
+  // Merge the table with fewer populated entries into the other one,
+  // so the cost of the merge is proportional to the smaller table.  In
+  // particular, merging into an empty table just swaps pointers.
+  if ((*right)->table_size > (*left)->table_size) {
     cc_hashtable_t *tmp = *left;
     *left = *right;
     *right = tmp;
   }
 
-  /* fprintf(stderr, "\tleft list_size = %d, right list_size = %d\n", */
-  /* 	  (*left)->list_size, (*right)->list_size); */
-
-  if (NULL != (*left)->tail) {
-    (*left)->tail->next = (*right)->head;
-  } else {
-    assert(NULL == (*left)->head);
-    (*left)->head = (*right)->head;
-    // XXX: Why not just do this?  Does it matter if both are NULL?
-    /* (*left)->tail = (*right)->tail; */
-  }
-  (*left)->list_size += (*right)->list_size;
-  if (NULL != (*right)->tail) {
-    (*left)->tail = (*right)->tail;
+  /* fprintf(stderr, "\tleft log_size = %d, right log_size = %d\n", */
+  /* 	  (*left)->log_size, (*right)->log_size); */
+
+  // Concatenate the logs.  If the left log is empty, just trade log
+  // arrays.
+  if (0 == (*left)->log_size) {
+    cc_hashtable_log_el_t *tmp_log = (*left)->log;
+    int tmp_log_capacity = (*left)->log_capacity;
+    (*left)->log = (*right)->log;
+    (*left)->log_capacity = (*right)->log_capacity;
+    (*left)->log_size = (*right)->log_size;
+    (*right)->log = tmp_log;
+    (*right)->log_capacity = tmp_log_capacity;
+  } else if ((*right)->log_size > 0) {
+    reserve_cc_log(*left, (*left)->log_size + (*right)->log_size);
+    memcpy(&((*left)->log[ (*left)->log_size ]), (*right)->log,
+           sizeof(cc_hashtable_log_el_t) * (*right)->log_size);
+    (*left)->log_size += (*right)->log_size;
   }
-  (*right)->head = NULL;
-  (*right)->tail = NULL;
-  (*right)->list_size = 0;
+  (*right)->log_size = 0;
 
-  /* fprintf(stderr, "list_size = %d, table_size = %d, lg_capacity = %d\n", */
-  /* 	  (*left)->list_size, (*left)->table_size, (*left)->lg_capacity); */
+  /* fprintf(stderr, "log_size = %d, table_size = %d, lg_capacity = %d\n", */
+  /* 	  (*left)->log_size, (*left)->table_size, (*left)->lg_capacity); */
 
-  if ((*left)->list_size >= MIN_CAPACITY * TABLE_CONSTANT) {
-    flush_cc_hashtable_list(left);
+  if ((*left)->log_size >= *((*left)->min_capacity) * TABLE_CONSTANT) {
+    flush_cc_hashtable_log(left);
   }
 
-  cc_hashtable_entry_t *l_entry, *r_entry;
-  for (size_t i = 0; i < (*right)->table_size; ++i) {
-
-    r_entry = &((*right)->entries[ (*right)->populated[i] ]);
-    assert(!empty_cc_entry_p(r_entry));
-
-    l_entry = &((*left)->entries[ (*right)->populated[i] ]);
-    assert(NULL != l_entry);
-    assert(empty_cc_entry_p(l_entry) || can_override_entry(l_entry, r_entry->rip));
-
-    if (empty_cc_entry_p(l_entry)) {
-      // let the compiler do the struct copy
-      *l_entry = *r_entry;
-      (*left)->populated[ (*left)->table_size ] = (*right)->populated[i];
-      ++(*left)->table_size;
-    } else {
-      combine_entries(l_entry, r_entry);
-    }
-
-  }
+  combine_cc_hashtable_entries(left, *right);
 
   return *left;
 }
 
+// Add the entries of the cc_hashtable *src, whose log must be empty,
+// into the cc_hashtable **dst.  Unlike add_cc_hashtables, *src is left
+// unchanged.
+void accumulate_cc_hashtable(cc_hashtable_t **dst, const cc_hashtable_t *src) {
+  assert(0 == src->log_size);
+  combine_cc_hashtable_entries(dst, src);
+}
+
 // Clear all entries in tab.
 void clear_cc_hashtable(cc_hashtable_t *tab) {
-  // Clear the linked list
-  /* cc_hashtable_list_el_t *lst_entry = tab->head; */
-  /* while (NULL != lst_entry) { */
-  /*   cc_hashtable_list_el_t *next_lst_entry = lst_entry->next; */
-  /*   free(lst_entry); */
-  /*   lst_entry = next_lst_entry; */
-  /* } */
-  if (NULL != tab->head) {
-    assert(NULL != tab->tail);
-    tab->tail->next = ll_free_list;
-    ll_free_list = tab->head;
-  }
-
-  tab->head = NULL;
-  tab->tail = NULL;
-  tab->list_size = 0;
-
-  // Clear the table
-  for (size_t i = 0; i < tab->table_size; ++i) {
-    make_empty_cc_entry(&(tab->entries[ tab->populated[i] ]));
+  // Clear the log, keeping its storage for reuse
+  tab->log_size = 0;
+
+  // Clear the table by advancing its epoch.  When the epoch wraps
+  // around, reset the entries so that no stale entry matches.
+  if (0 == tab->table_size)
+    return;
+  if (0 == ++tab->epoch) {
+    for (size_t i = 0; i < (1 << tab->lg_capacity); ++i) {
+      make_empty_cc_entry(&(tab->entries[i]));
+    }
+    tab->epoch = 1;
   }
   tab->table_size = 0;
 }
 
-// Free a table.
+// Return a table to the pool of free tables.
 void free_cc_hashtable(cc_hashtable_t *tab) {
-  // Clear the linked list
-  /* cc_hashtable_list_el_t *lst_entry = tab->head; */
-  /* while (NULL != lst_entry) { */
-  /*   cc_hashtable_list_el_t *next_lst_entry = lst_entry->next; */
-  /*   free(lst_entry); */
-  /*   lst_entry = next_lst_entry; */
-  /* } */
-  if (NULL != tab->head) {
-    assert(NULL != tab->tail);
-    tab->tail->next = ll_free_list;
-    ll_free_list = tab->head;
+  clear_cc_hashtable(tab);
+  tab->next_free = cc_table_pool[tab->lg_capacity];
+  cc_table_pool[tab->lg_capacity] = tab;
+}
+
+// Free the tables in the pool of free tables.
+void cc_hashtable_pool_free(void) {
+  for (int lg = 0; lg < CC_POOL_LEVELS; ++lg) {
+    while (NULL != cc_table_pool[lg]) {
+      cc_hashtable_t *next = cc_table_pool[lg]->next_free;
+      free(cc_table_pool[lg]->log);
+      free(cc_table_pool[lg]);
+      cc_table_pool[lg] = next;
+    }
   }
-  free(tab->populated);
-  free(tab);
 }
 
 bool cc_hashtable_is_empty(const cc_hashtable_t *tab) {
-  return tab->table_size == 0 && tab->list_size == 0;
+  return tab->table_size == 0 && tab->log_size == 0;
 }
@@ -5,6 +5,8 @@
 #include <inttypes.h>
 
 #include "util.h"
+#include "strand_counters.h"
+#include "burdening.h"
 
 /**
  * Data structures
@@ -20,8 +22,9 @@ typedef struct {
   /* bool is_recursive; */
 
 
-  // Store whether this entry is initialized
-  uint32_t initialized;
+  // Epoch of the table when this entry was initialized.  The entry is
+  // valid only if this matches the current epoch of its table.
+  uint32_t epoch;
 
 #ifndef NDEBUG
   // Function type.  Least-significant bit indicates whether the
@@ -53,51 +56,80 @@ typedef struct {
   // Span associated with top-level invocations of rip
   uint64_t top_spn;
 
+#if BURDENED_SPAN
+  // Burdened span associated with rip, excluding recursive instances
+  uint64_t bspn;
+  // Burdened span associated with top-level invocations of rip
+  uint64_t top_bspn;
+#endif
+
+#if STRAND_PERF
+  // Hardware-counter analogues of the work and span fields above
+  strand_counters_t local_wrk_ctr;
+  strand_counters_t local_spn_ctr;
+  strand_counters_t wrk_ctr;
+  strand_counters_t spn_ctr;
+  strand_counters_t top_wrk_ctr;
+  strand_counters_t top_spn_ctr;
+#endif
+
 } cc_hashtable_entry_t;
 
-// Structure for making a linked list of cc_hashtable entries
-typedef struct cc_hashtable_list_el_t {
+// Structure for a record in the staging log of cc_hashtable entries
+typedef struct {
   // Index in table for this entry
   uint32_t index;
 
-  // Pointer to next entry in table
-  struct cc_hashtable_list_el_t* next;
-
   // Hashtable entry data
   cc_hashtable_entry_t entry;
 
-} cc_hashtable_list_el_t;
+} cc_hashtable_log_el_t;
 
 // Structure for the hashtable
-typedef struct {
+typedef struct cc_hashtable_t {
   // Lg of capacity of hash table
   int lg_capacity;
 
-  // Number of elements in list
-  int list_size;
+  // Number of records in log
+  int log_size;
+
+  // Capacity of log
+  int log_capacity;
 
   // Number of elements in table
   int table_size;
 
-  // Linked list of entries to add to hashtable
-  cc_hashtable_list_el_t *head;
-  cc_hashtable_list_el_t *tail;
+  // Current epoch of the table.  Clearing the table advances the
+  // epoch, which invalidates all entries at once.
+  uint32_t epoch;
 
-  // Array storing indices of entries[] that are nonzero
+  // Bound on the indices stored in the table, which determines the
+  // capacity on resize and the length of the log.  Call-site tables
+  // use MIN_CAPACITY.
+  const int *min_capacity;
+
+  // Contiguous log of entries to add to hashtable
+  cc_hashtable_log_el_t *log;
+
+  // Array storing indices of entries[] that are nonzero.  It is
+  // allocated together with the table, after entries[].
   int *populated;
 
+  // Next table in the pool of free tables
+  struct cc_hashtable_t *next_free;
+
   // Entries of the hash table
   cc_hashtable_entry_t entries[0];
 
 } cc_hashtable_t;
 
-extern cc_hashtable_list_el_t *ll_free_list;  
-
 /**
  * Exposed hashtable methods
  */
-bool empty_cc_entry_p(const cc_hashtable_entry_t *entry);
+bool empty_cc_entry_p(const cc_hashtable_t *tab,
+                      const cc_hashtable_entry_t *entry);
 cc_hashtable_t* cc_hashtable_create(void);
+cc_hashtable_t* cc_hashtable_create_bounded(const int *min_capacity);
 void clear_cc_hashtable(cc_hashtable_t *tab);
 void flush_cc_hashtable(cc_hashtable_t **tab);
 bool add_to_cc_hashtable(cc_hashtable_t **tab,
@@ -106,6 +138,15 @@ bool add_to_cc_hashtable(cc_hashtable_t **tab,
                          uint32_t index,
 #ifndef NDEBUG
                          uintptr_t rip,
+#endif
+#if STRAND_PERF
+                         const strand_counters_t *wrk_ctr,
+                         const strand_counters_t *spn_ctr,
+                         const strand_counters_t *local_wrk_ctr,
+                         const strand_counters_t *local_spn_ctr,
+#endif
+#if BURDENED_SPAN
+                         uint64_t bspn,
 #endif
                          uint64_t wrk, uint64_t spn,
                          uint64_t local_wrk, uint64_t local_spn);
@@ -113,11 +154,17 @@ bool add_local_to_cc_hashtable(cc_hashtable_t **tab,
                                uint32_t index,
 #ifndef NDEBUG
                                uintptr_t rip,
+#endif
+#if STRAND_PERF
+                               const strand_counters_t *local_wrk_ctr,
+                               const strand_counters_t *local_spn_ctr,
 #endif
                                uint64_t local_wrk, uint64_t local_spn);
 cc_hashtable_t* add_cc_hashtables(cc_hashtable_t **left,
 				  cc_hashtable_t **right);
+void accumulate_cc_hashtable(cc_hashtable_t **dst, const cc_hashtable_t *src);
 void free_cc_hashtable(cc_hashtable_t *tab);
+void cc_hashtable_pool_free(void);
 bool cc_hashtable_is_empty(const cc_hashtable_t *tab);
 
 #endif
@@ -14,10 +14,13 @@
 #include <sys/types.h>
 
 #include <cilktool.h>
+#include <cilkprof.h>
 
 #include "cilkprof_stack.h"
 #include "iaddrs.h"
 #include "util.h"
+#include <speedup.h>
+#include "profile_formats.h"
 
 #ifndef SERIAL_TOOL
 #define SERIAL_TOOL 1
@@ -35,14 +38,22 @@
 #define TRACE_CALLS 0
 #endif
 
-#ifndef BURDENING
-#define BURDENING 0
-#endif
-
 #ifndef PRINT_RES
 #define PRINT_RES 1
 #endif
 
+// Set SNAPSHOTS to 1 to allow snapshots of the profile while the
+// program runs.  A snapshot is taken on SIGUSR2, and every
+// CILKPROF_SNAPSHOT_INTERVAL_MS milliseconds if that environment
+// variable is set.
+#ifndef SNAPSHOTS
+#define SNAPSHOTS 0
+#endif
+
+#if SNAPSHOTS
+#include <signal.h>
+#endif
+
 #if SERIAL_TOOL
 #define GET_STACK(ex) ex
 #else
@@ -61,6 +72,15 @@
 #define WHEN_TRACE_CALLS(ex) do {} while (0)
 #endif
 
+#if CRITICAL_PATH
+#if !SERIAL_TOOL
+#error "CRITICAL_PATH requires SERIAL_TOOL"
+#endif
+#define WHEN_CRITICAL_PATH(ex) do { ex } while (0)
+#else
+#define WHEN_CRITICAL_PATH(ex) do {} while (0)
+#endif
+
 /*************************************************************************/
 /**
  * Data structures for tracking work and span.
@@ -81,6 +101,37 @@ static CILK_C_DECLARE_REDUCER(cilkprof_stack_t) ctx_stack =
 
 iaddr_table_t *call_site_table;
 static iaddr_table_t *function_table;
+#if COMPUTE_STRAND_DATA
+static strand_id_table_t *strand_id_table;
+#endif
+
+// Profiles of regions, in order of first execution
+static cilkprof_region_t *regions = NULL;
+static cilkprof_region_t **regions_tail = &regions;
+// Set from CILKPROF_REGIONS_ONLY to measure only strands inside regions
+static bool REGIONS_ONLY = false;
+
+#if BURDENED_SPAN
+// Burdens of a spawned child, of the continuation of a spawn, and of a
+// sync of spawned children
+static uint64_t SPAWN_BURDEN = BURDENING;
+static uint64_t CONTIN_BURDEN = BURDENING;
+static uint64_t SYNC_BURDEN = BURDENING;
+#endif
+
+#if COLLAPSE_SHORT_CALLS
+// A call from a C call site is short if it calls nothing and its length
+// is at most COLLAPSE_THRESHOLD.  A call site is collapsed after
+// COLLAPSE_AFTER_CALLS consecutive short calls.  Both are read from
+// CILKPROF_COLLAPSE_THRESHOLD and CILKPROF_COLLAPSE_AFTER_CALLS.
+static uint64_t COLLAPSE_THRESHOLD = 200;
+static uint64_t COLLAPSE_AFTER_CALLS = 1024;
+#endif
+
+#if CALIBRATE_OVERHEAD
+// Overhead of the hooks included in each measured strand
+static overhead_t STRAND_OVERHEAD = { 0, 0 };
+#endif
 
 static bool TOOL_INITIALIZED = false;
 static bool TOOL_PRINTED = false;
@@ -89,17 +140,246 @@ static int TOOL_PRINT_NUM = 0;
 extern int MIN_CAPACITY;
 /* extern int MIN_LG_CAPACITY; */
 
+/*************************************************************************/
+/**
+ * Snapshots.
+ */
+
+#if SNAPSHOTS
+// Set asynchronously to request a snapshot at the next strand boundary
+static volatile sig_atomic_t snapshot_requested = 0;
+static int SNAPSHOT_NUM = 0;
+
+static bool snapshot_timer_created = false;
+static timer_t snapshot_timer;
+static struct timespec snapshot_epoch;
+
+static FILE *snapshot_fout = NULL;
+static FILE *snapshot_cs_fout = NULL;
+
+// Work-table data of each call site as of the previous snapshot,
+// together with its source location, indexed by call-site index
+typedef struct {
+  uint64_t wrk;
+  uint64_t local_wrk;
+  uint32_t count;
+  uint32_t local_count;
+  int line;
+  char *file;
+} snapshot_cs_t;
+
+static snapshot_cs_t *snapshot_cs = NULL;
+static int snapshot_cs_capacity = 0;
+
+static uint64_t snapshot_prev_work = 0;
+static uint64_t snapshot_prev_span = 0;
+
+static void snapshot_handler(int sig) {
+  snapshot_requested = 1;
+}
+
+static void init_snapshots(void) {
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = snapshot_handler;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGUSR2, &sa, NULL)) {
+    perror("cilkprof: sigaction");
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &snapshot_epoch);
+
+  const char *e = getenv("CILKPROF_SNAPSHOT_INTERVAL_MS");
+  long interval_ms = e ? atol(e) : 0;
+  if (interval_ms <= 0)
+    return;
+
+  struct sigevent sev;
+  memset(&sev, 0, sizeof(sev));
+  sev.sigev_notify = SIGEV_SIGNAL;
+  sev.sigev_signo = SIGUSR2;
+  if (timer_create(CLOCK_MONOTONIC, &sev, &snapshot_timer)) {
+    perror("cilkprof: timer_create");
+    return;
+  }
+  snapshot_timer_created = true;
+
+  struct itimerspec its;
+  its.it_value.tv_sec = interval_ms / 1000;
+  its.it_value.tv_nsec = (interval_ms % 1000) * 1000000;
+  its.it_interval = its.it_value;
+  timer_settime(snapshot_timer, 0, &its, NULL);
+}
+
+static void destroy_snapshots(void) {
+  if (snapshot_timer_created) {
+    timer_delete(snapshot_timer);
+    snapshot_timer_created = false;
+  }
+  signal(SIGUSR2, SIG_DFL);
+  if (snapshot_fout) {
+    fclose(snapshot_fout);
+    snapshot_fout = NULL;
+  }
+  if (snapshot_cs_fout) {
+    fclose(snapshot_cs_fout);
+    snapshot_cs_fout = NULL;
+  }
+  for (int i = 0; i < snapshot_cs_capacity; ++i) {
+    free(snapshot_cs[i].file);
+  }
+  free(snapshot_cs);
+  snapshot_cs = NULL;
+  snapshot_cs_capacity = 0;
+}
+
+// Compute the work and span of the computation executed so far, by
+// folding the in-progress frames of the stack into their parents.
+static void measure_work_span_so_far(const cilkprof_stack_t *stack,
+                                     uint64_t *work, uint64_t *span) {
+  uint64_t wrk = 0, spn = 0;
+  const cilkprof_stack_frame_t *frame = stack->bot;
+  for (int32_t k = stack->c_tail; k >= 0; --k) {
+    const c_fn_frame_t *c_frame = &(stack->c_stack[k]);
+    wrk += c_frame->running_wrk + c_frame->local_wrk;
+    if (NULL != frame && k == frame->c_head) {
+      // In-progress children extend the continuation of this frame.
+      uint64_t contin = c_frame->running_spn + frame->local_contin + spn;
+      spn = frame->prefix_spn + frame->local_spn +
+          ((frame->lchild_spn > contin) ? frame->lchild_spn : contin);
+      frame = frame->parent;
+    } else {
+      spn += c_frame->running_spn + c_frame->local_wrk;
+    }
+  }
+  *work = wrk;
+  *span = spn;
+}
+
+// Write the changes in the profile since the previous snapshot.
+// Call-site data reflects invocations that have returned.
+static void take_snapshot(cilkprof_stack_t *stack) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t time_ns = (now.tv_sec - snapshot_epoch.tv_sec) * 1000000000ULL
+      + now.tv_nsec - snapshot_epoch.tv_nsec;
+
+  if (NULL == snapshot_fout) {
+    snapshot_fout = fopen("cilkprof_snapshot.csv", "w");
+    snapshot_cs_fout = fopen("cilkprof_snapshot_cs.csv", "w");
+    if (NULL == snapshot_fout || NULL == snapshot_cs_fout) {
+      perror("cilkprof: cannot open snapshot files");
+      return;
+    }
+    fprintf(snapshot_fout, "snapshot, time (ns), work, span, parallelism, ");
+    fprintf(snapshot_fout, "delta work, delta span, delta parallelism \n");
+    fprintf(snapshot_cs_fout, "snapshot, file, line, call sites (rip), function type, ");
+    fprintf(snapshot_cs_fout, "delta work on work, delta count on work, ");
+    fprintf(snapshot_cs_fout, "delta local work on work, delta local count on work \n");
+  }
+
+  uint64_t work, span;
+  measure_work_span_so_far(stack, &work, &span);
+  uint64_t delta_work = work - snapshot_prev_work;
+  uint64_t delta_span = span - snapshot_prev_span;
+  fprintf(snapshot_fout, "%d, %lu, %lu, %lu, %g, %lu, %lu, %g\n",
+          SNAPSHOT_NUM, time_ns, work, span, (double)work / (double)span,
+          delta_work, delta_span, (double)delta_work / (double)delta_span);
+  snapshot_prev_work = work;
+  snapshot_prev_span = span;
+
+  flush_cc_hashtable(&(stack->wrk_table));
+  const cc_hashtable_t *work_table = stack->wrk_table;
+
+  if (snapshot_cs_capacity < (1 << work_table->lg_capacity)) {
+    int new_capacity = 1 << work_table->lg_capacity;
+    snapshot_cs = (snapshot_cs_t*)realloc(snapshot_cs,
+                                          sizeof(snapshot_cs_t) * new_capacity);
+    memset(snapshot_cs + snapshot_cs_capacity, 0,
+           sizeof(snapshot_cs_t) * (new_capacity - snapshot_cs_capacity));
+    snapshot_cs_capacity = new_capacity;
+  }
+
+  bool maps_read = false;
+  for (size_t i = 0; i < (1 << (call_site_table->lg_capacity)); ++i) {
+    iaddr_record_t *record = call_site_table->records[i];
+    while (NULL != record) {
+      int32_t index = record->index;
+      if (index >= (1 << work_table->lg_capacity)) {
+        record = record->next;
+        continue;
+      }
+      const cc_hashtable_entry_t *entry = &(work_table->entries[index]);
+      snapshot_cs_t *prev = &(snapshot_cs[index]);
+      if (empty_cc_entry_p(work_table, entry) ||
+          (entry->count == prev->count &&
+           entry->local_count == prev->local_count)) {
+        record = record->next;
+        continue;
+      }
+
+      uint64_t addr = rip2cc(record->iaddr);
+      if (NULL == prev->file) {
+        // Look up and cache the source location of this call site
+        if (!maps_read) {
+          read_proc_maps();
+          maps_read = true;
+        }
+        char *fstr = NULL;
+        char *line_to_free = get_info_on_inst_addr(addr, &(prev->line), &fstr);
+        prev->file = strdup(fstr ? basename(fstr) : "??");
+        if (line_to_free) free(line_to_free);
+      }
+
+      fprintf(snapshot_cs_fout, "%d, \"%s\", %d, 0x%lx, %s, ",
+              SNAPSHOT_NUM, prev->file, prev->line, addr,
+              FunctionType_str[record->func_type]);
+      fprintf(snapshot_cs_fout, "%lu, %u, %lu, %u\n",
+              entry->wrk - prev->wrk, entry->count - prev->count,
+              entry->local_wrk - prev->local_wrk,
+              entry->local_count - prev->local_count);
+
+      prev->wrk = entry->wrk;
+      prev->count = entry->count;
+      prev->local_wrk = entry->local_wrk;
+      prev->local_count = entry->local_count;
+
+      record = record->next;
+    }
+  }
+  if (maps_read)
+    free_proc_maps();
+
+  fflush(snapshot_fout);
+  fflush(snapshot_cs_fout);
+  ++SNAPSHOT_NUM;
+}
+#endif
+
 /*************************************************************************/
 /**
  * Helper methods.
  */
 
+#if BURDENED_SPAN || COLLAPSE_SHORT_CALLS || CALIBRATE_OVERHEAD
+// Set *param from the environment variable var, if it is set.
+static void read_param(const char *var, uint64_t *param) {
+  const char *e = getenv(var);
+  if (NULL != e)
+    *param = strtoull(e, NULL, 0);
+}
+#endif
+
 static inline void initialize_tool(cilkprof_stack_t *stack) {
 #if SERIAL_TOOL
   // This is a serial tool
   ensure_serial_tool();
   call_site_table = iaddr_table_create();
   function_table = iaddr_table_create();
+#if COMPUTE_STRAND_DATA
+  strand_id_table = strand_id_table_create();
+#endif
 #else
   int P = __cilkrts_get_nworkers();
   wls = (cilkprof_wls_t*)malloc(sizeof(cilkprof_wls_t) * P);
@@ -110,45 +390,510 @@ static inline void initialize_tool(cilkprof_stack_t *stack) {
   CILK_C_REGISTER_REDUCER(ctx_stack);
 #endif
   cilkprof_stack_init(stack, MAIN);
+#if BURDENED_SPAN
+  read_param("CILKPROF_SPAWN_BURDEN", &SPAWN_BURDEN);
+  read_param("CILKPROF_CONTIN_BURDEN", &CONTIN_BURDEN);
+  read_param("CILKPROF_SYNC_BURDEN", &SYNC_BURDEN);
+#endif
+#if COLLAPSE_SHORT_CALLS
+  read_param("CILKPROF_COLLAPSE_THRESHOLD", &COLLAPSE_THRESHOLD);
+  read_param("CILKPROF_COLLAPSE_AFTER_CALLS", &COLLAPSE_AFTER_CALLS);
+#endif
+#if CALIBRATE_OVERHEAD
+  STRAND_OVERHEAD = calibrate_overhead(&(stack->strand_ruler));
+  read_param("CILKPROF_OVERHEAD", &(STRAND_OVERHEAD.per_strand));
+#endif
+  const char *regions_only = getenv("CILKPROF_REGIONS_ONLY");
+  REGIONS_ONLY = (NULL != regions_only && 0 != atoi(regions_only));
+#if SNAPSHOTS
+  init_snapshots();
+#endif
   TOOL_INITIALIZED = true;
   TOOL_PRINTED = false;
 }
 
+#if COLLAPSE_SHORT_CALLS
+// Record whether the call that just returned in frame, from the call
+// site with the given status, was short, and collapse the call site
+// after enough consecutive short calls.
+static inline void observe_call_length(cs_status_t *status,
+                                       const c_fn_frame_t *frame) {
+  if (0 == frame->running_wrk && frame->local_wrk <= COLLAPSE_THRESHOLD) {
+    if (++status->short_calls >= COLLAPSE_AFTER_CALLS)
+      status->flags |= COLLAPSED;
+  } else {
+    status->short_calls = 0;
+  }
+}
+#endif
+
 __attribute__((always_inline))
 void begin_strand(cilkprof_stack_t *stack) {
+  if (REGIONS_ONLY && NULL == stack->region)
+    return;
+#if SNAPSHOTS
+  // Take a pending snapshot between strands, so that its cost is not
+  // attributed to any strand.
+  if (__builtin_expect(snapshot_requested, 0)) {
+    snapshot_requested = 0;
+    take_snapshot(stack);
+  }
+#endif
   start_strand(&(stack->strand_ruler));
 }
 
 __attribute__((always_inline))
 uint64_t measure_and_add_strand_length(cilkprof_stack_t *stack) {
+  // Strands outside of regions are not measured in regions-only mode.
+  if (REGIONS_ONLY && NULL == stack->region)
+    return 0;
+
   // Measure strand length
   uint64_t strand_len = measure_strand_length(&(stack->strand_ruler));
   assert(NULL != stack->bot);
+  WHEN_CALIBRATE_OVERHEAD( strand_len = remove_overhead(strand_len, &STRAND_OVERHEAD);
+                           ++stack->num_strands; );
 
   // Accumulate strand length
   stack->c_stack[stack->c_tail].local_wrk += strand_len;
+  // Strands of a Cilk function itself lie on its continuation.
+  WHEN_BURDENED_SPAN( if (stack->bot->c_head == stack->c_tail)
+                        stack->bot->contin_bspn += strand_len; );
+  WHEN_STRAND_PERF( add_strand_counters(&(stack->c_stack[stack->c_tail].local_wrk_ctr),
+                                        &(stack->strand_ruler.counts)); );
+  WHEN_CRITICAL_PATH( c_fn_frame_t *c_frame = &(stack->c_stack[stack->c_tail]);
+                      c_frame->path = path_append_segment(c_frame->path,
+                                                          c_frame->cs_index,
+                                                          strand_len); );
   /* stack->bot->c_fn_frame->local_wrk += strand_len; */
   /* stack->bot->c_fn_frame->local_contin += strand_len; */
   /* stack->bot->c_fn_frame->running_wrk += strand_len; */
   /* stack->bot->c_fn_frame->contin_spn += strand_len; */
 
 #if COMPUTE_STRAND_DATA
-  // Add strand length to strand_wrk and strand_contin tables
+  // Add strand length to strand_wrk table and to the strand table of
+  // the current prefix or continuation.
   /* fprintf(stderr, "start %lx, end %lx\n", stack->strand_start, stack->strand_end); */
-  bool add_success = add_to_strand_hashtable(&(stack->strand_wrk_table),
-                                             stack->strand_start,
-                                             stack->strand_end,
-                                             strand_len);
+  int32_t strand_index = add_to_strand_id_table(&strand_id_table,
+                                                stack->strand_start,
+                                                stack->strand_end);
+  cc_hashtable_t **dst_strand_table;
+  if (0 == stack->bot->lchild_spn) {
+    dst_strand_table = &(stack->bot->strand_prefix_table);
+  } else {
+    dst_strand_table = &(stack->bot->strand_contin_table);
+  }
+  bool add_success = add_local_to_cc_hashtable(&(stack->strand_wrk_table),
+                                               strand_index,
+#ifndef NDEBUG
+                                               stack->strand_start,
+#endif
+#if STRAND_PERF
+                                               &(stack->strand_ruler.counts),
+                                               &(stack->strand_ruler.counts),
+#endif
+                                               strand_len, strand_len);
   assert(add_success);
-  add_success = add_to_strand_hashtable(&(stack->bot->strand_contin_table),
-                                        stack->strand_start,
-                                        stack->strand_end,
-                                        strand_len);
+  add_success = add_local_to_cc_hashtable(dst_strand_table,
+                                          strand_index,
+#ifndef NDEBUG
+                                          stack->strand_start,
+#endif
+#if STRAND_PERF
+                                          &(stack->strand_ruler.counts),
+                                          &(stack->strand_ruler.counts),
+#endif
+                                          strand_len, strand_len);
   assert(add_success);
 #endif
   return strand_len;
 }
 
+#if BURDENED_SPAN
+// Print the burdened-span fields of entry as CSV columns.  A NULL
+// entry prints zero spans.
+static void print_entry_burdened_span(FILE *fout, const cc_hashtable_entry_t *entry) {
+  if (NULL == entry) {
+    fprintf(fout, ", 0, %g, 0, %g", DBL_MAX, DBL_MAX);
+  } else {
+    fprintf(fout, ", %lu, %g, %lu, %g",
+            entry->bspn, (double)entry->wrk / (double)entry->bspn,
+            entry->top_bspn, (double)entry->top_wrk / (double)entry->top_bspn);
+  }
+}
+#endif
+
+#if STRAND_PERF
+// Print the CSV column headers for the hardware-counter fields of a
+// call-site entry, once for the work table and once for the span
+// table.
+static void print_counters_header(FILE *fout) {
+  const char *table[2] = { "work", "span" };
+  for (int t = 0; t < 2; ++t) {
+    for (int i = 0; i < NUM_STRAND_COUNTERS; ++i) {
+      const char *name = strand_counter_names[i];
+      fprintf(fout, ", %s work on %s, %s span on %s, "
+              "top %s work on %s, top %s span on %s, "
+              "local %s work on %s, local %s span on %s",
+              name, table[t], name, table[t],
+              name, table[t], name, table[t],
+              name, table[t], name, table[t]);
+    }
+  }
+}
+
+// Print the hardware-counter fields of entry as CSV columns.  A NULL
+// entry prints zeros.
+static void print_entry_counters(FILE *fout, const cc_hashtable_entry_t *entry) {
+  for (int i = 0; i < NUM_STRAND_COUNTERS; ++i) {
+    if (NULL == entry) {
+      fprintf(fout, ", 0, 0, 0, 0, 0, 0");
+    } else {
+      fprintf(fout, ", %lu, %lu, %lu, %lu, %lu, %lu",
+              entry->wrk_ctr.c[i], entry->spn_ctr.c[i],
+              entry->top_wrk_ctr.c[i], entry->top_spn_ctr.c[i],
+              entry->local_wrk_ctr.c[i], entry->local_spn_ctr.c[i]);
+    }
+  }
+}
+#endif
+
+// Print the call-site data in work_table and span_table as CSV to
+// fout.
+static void print_call_site_csv(FILE *fout, const cilkprof_stack_t *stack,
+                                const cc_hashtable_t *work_table,
+                                const cc_hashtable_t *span_table) {
+  // print the header for the csv file
+  /* fprintf(fout, "file, line, call sites (rip), depth, "); */
+  fprintf(fout, "file, line, call sites (rip), function type, ");
+  fprintf(fout, "work on work, span on work, parallelism on work, count on work, ");
+  fprintf(fout, "top work on work, top span on work, top parallelism on work, top count on work, ");
+  fprintf(fout, "local work on work, local span on work, local parallelism on work, local count on work, ");
+  fprintf(fout, "work on span, span on span, parallelism on span, count on span, ");
+  fprintf(fout, "top work on span, top span on span, top parallelism on span, top count on span, ");
+  fprintf(fout, "local work on span, local span on span, local parallelism on span, local count on span");
+  WHEN_BURDENED_SPAN(
+      fprintf(fout, ", burdened span on work, burdened parallelism on work, ");
+      fprintf(fout, "top burdened span on work, top burdened parallelism on work, ");
+      fprintf(fout, "burdened span on span, burdened parallelism on span, ");
+      fprintf(fout, "top burdened span on span, top burdened parallelism on span"); );
+  WHEN_STRAND_PERF( print_counters_header(fout); );
+  fprintf(fout, " \n");
+
+  // Parse tables
+  int span_table_entries_read = 0;
+  for (size_t i = 0; i < (1 << (call_site_table->lg_capacity)); ++i) {
+    iaddr_record_t *record = call_site_table->records[i];
+    /* fprintf(stderr, "\n"); */
+    while (NULL != record /* && (uintptr_t)NULL != record->iaddr */) {
+      /* fprintf(stderr, "rip %p (%d), ", record->iaddr, record->index); */
+
+      assert(0 != record->iaddr);
+      assert(0 <= record->index);
+
+      // Tables of regions may not cover call sites added after them.
+      if (record->index >= (1 << work_table->lg_capacity)) {
+        record = record->next;
+        continue;
+      }
+
+      const cc_hashtable_entry_t *entry = &(work_table->entries[ record->index ]);
+      /* fprintf(stderr, "%p\n", entry->rip); */
+      /* if (entry->rip != record->iaddr) { */
+      if (empty_cc_entry_p(work_table, entry)) {
+        record = record->next;
+        continue;
+      }
+
+      assert(entry->rip == record->iaddr);
+
+      uint64_t wrk_wrk = entry->wrk;
+      uint64_t spn_wrk = entry->spn;
+      double par_wrk = (double)wrk_wrk/(double)spn_wrk;
+      uint64_t cnt_wrk = entry->count;
+
+      uint64_t t_wrk_wrk = entry->top_wrk;
+      uint64_t t_spn_wrk = entry->top_spn;
+      double t_par_wrk = (double)t_wrk_wrk/(double)t_spn_wrk;
+      uint64_t t_cnt_wrk = entry->top_count;
+
+      uint64_t l_wrk_wrk = entry->local_wrk;
+      uint64_t l_spn_wrk = entry->local_spn;
+      double l_par_wrk = (double)l_wrk_wrk/(double)l_spn_wrk;
+      uint64_t l_cnt_wrk = entry->local_count;
+
+      uint64_t wrk_spn = 0;
+      uint64_t spn_spn = 0;
+      double par_spn = DBL_MAX;
+      uint64_t cnt_spn = 0;
+
+      uint64_t t_wrk_spn = 0;
+      uint64_t t_spn_spn = 0;
+      double t_par_spn = DBL_MAX;
+      uint64_t t_cnt_spn = 0;
+
+      uint64_t l_wrk_spn = 0;
+      uint64_t l_spn_spn = 0;
+      double l_par_spn = DBL_MAX;
+      uint64_t l_cnt_spn = 0;
+
+#if BURDENED_SPAN || STRAND_PERF
+      const cc_hashtable_entry_t *span_table_entry = NULL;
+#endif
+      if (record->index < (1 << span_table->lg_capacity)) {
+        const cc_hashtable_entry_t *st_entry = &(span_table->entries[ record->index ]);
+
+        if (!empty_cc_entry_p(span_table, st_entry)) {
+          assert(st_entry->rip == entry->rip);
+#if BURDENED_SPAN || STRAND_PERF
+          span_table_entry = st_entry;
+#endif
+
+          wrk_spn = st_entry->wrk;
+          spn_spn = st_entry->spn;
+          par_spn = (double)wrk_spn / (double)spn_spn;
+          cnt_spn = st_entry->count;
+
+          t_wrk_spn = st_entry->top_wrk;
+          t_spn_spn = st_entry->top_spn;
+          t_par_spn = (double)t_wrk_spn / (double)t_spn_spn;
+          t_cnt_spn = st_entry->top_count;
+
+          l_wrk_spn = st_entry->local_wrk;
+          l_spn_spn = st_entry->local_spn;
+          l_par_spn = (double)l_wrk_spn / (double)l_spn_spn;
+          l_cnt_spn = st_entry->local_count;
+
+          ++span_table_entries_read;
+        }
+      }
+
+      int line = 0; 
+      char *fstr = NULL;
+      /* uint64_t addr = rip2cc(entry->rip); */
+      uint64_t addr = rip2cc(record->iaddr);
+
+      // get_info_on_inst_addr returns a char array from some system call that
+      // needs to get freed by the user after we are done with the info
+      char *line_to_free = get_info_on_inst_addr(addr, &line, &fstr);
+      char *file = basename(fstr);
+      /* fprintf(fout, "\"%s\", %d, 0x%lx, %d, ", file, line, addr, entry->depth); */
+      fprintf(fout, "\"%s\", %d, 0x%lx, ", file, line, addr);
+      /* if (entry->is_recursive) {  // recursive function */
+      /* if (entry->func_type & IS_RECURSIVE) {  // recursive function */
+      /* FunctionType_t func_type = (stack->cs_status[record->index].func_type & ~ON_STACK); */
+      FunctionType_t func_type = record->func_type;
+      if (stack->cs_status[record->index].flags & RECURSIVE) {  // recursive function
+        fprintf(fout, "%s %s",
+                FunctionType_str[func_type],
+                FunctionType_str[IS_RECURSIVE]);
+      } else {
+        fprintf(fout, "%s", FunctionType_str[func_type]);
+      }
+      // Calls from a collapsed call site stop being counted once it is
+      // collapsed.
+      if (stack->cs_status[record->index].flags & COLLAPSED)
+        fprintf(fout, " collapsed");
+      fprintf(fout, ", ");
+      fprintf(fout, "%lu, %lu, %g, %lu, %lu, %lu, %g, %lu, %lu, %lu, %g, %lu, ", 
+              wrk_wrk, spn_wrk, par_wrk, cnt_wrk,
+              t_wrk_wrk, t_spn_wrk, t_par_wrk, t_cnt_wrk,
+              l_wrk_wrk, l_spn_wrk, l_par_wrk, l_cnt_wrk);
+      fprintf(fout, "%lu, %lu, %g, %lu, %lu, %lu, %g, %lu, %lu, %lu, %g, %lu", 
+              wrk_spn, spn_spn, par_spn, cnt_spn,
+              t_wrk_spn, t_spn_spn, t_par_spn, t_cnt_spn,
+              l_wrk_spn, l_spn_spn, l_par_spn, l_cnt_spn);
+      WHEN_BURDENED_SPAN( print_entry_burdened_span(fout, entry);
+                          print_entry_burdened_span(fout, span_table_entry); );
+      WHEN_STRAND_PERF( print_entry_counters(fout, entry);
+                        print_entry_counters(fout, span_table_entry); );
+      fprintf(fout, "\n");
+      if(line_to_free) free(line_to_free);
+      
+      record = record->next;
+    }
+  }
+
+  /* if (span_table_entries_read != span_table->table_size) { */
+  /*   fprintf(stderr, "read %d, table contains %d\n", */
+  /*           span_table_entries_read, span_table->table_size); */
+  /* } */
+  assert(span_table_entries_read == span_table->table_size);
+}
+
+// Print the profile of each region to a CSV file, and a summary of all
+// regions to cilkprof_regions_N.csv.
+static void print_regions(const cilkprof_stack_t *stack) {
+  char filename[64];
+  sprintf(filename, "cilkprof_regions_%d.csv", TOOL_PRINT_NUM);
+  FILE *summary = fopen(filename, "w");
+  fprintf(summary, "region, name, count, work, span, parallelism \n");
+
+  int region_num = 0;
+  for (cilkprof_region_t *region = regions; NULL != region;
+       region = region->next, ++region_num) {
+    fprintf(summary, "%d, \"%s\", %u, %lu, %lu, %g\n",
+            region_num, region->name, region->count,
+            region->wrk, region->spn,
+            (double)region->wrk / (double)region->spn);
+
+    sprintf(filename, "cilkprof_region_%d_cs_%d.csv", region_num, TOOL_PRINT_NUM);
+    FILE *fout = fopen(filename, "w");
+    print_call_site_csv(fout, stack, region->wrk_table, region->spn_table);
+    fclose(fout);
+  }
+  fclose(summary);
+}
+
+// Print the predicted speedup on 1 to max_workers workers of a
+// computation with the given work, span, and burdened span, one row
+// per worker count, each row starting with the columns in prefix.
+static void print_speedup_rows(FILE *fout, const char *prefix, int max_workers,
+                               uint64_t wrk, uint64_t spn, uint64_t bspn) {
+  for (int P = 1; P <= max_workers; ++P) {
+    speedup_t s = predict_speedup(P, wrk, spn, bspn);
+    fprintf(fout, "%s%d, %lu, %lu, %g, %g", prefix, P, wrk, spn, s.upper, s.greedy);
+    WHEN_BURDENED_SPAN( fprintf(fout, ", %lu, %g", bspn, s.burdened); );
+    fprintf(fout, "\n");
+  }
+}
+
+// Print the predicted speedup curve of the whole program and of each
+// call site invoked at the top level to cilkprof_speedup_N.csv.  The
+// curve of a call site treats its top-level invocations as one
+// computation, with their total work and span.
+static void print_speedup_csv(const cilkprof_stack_t *stack,
+                              const cc_hashtable_t *work_table,
+                              uint64_t work, uint64_t span,
+                              uint64_t burdened_span) {
+  char filename[64];
+  char prefix[PATH_MAX + 128];
+  int max_workers = speedup_max_workers("CILKPROF_SPEEDUP_MAX_P");
+
+  sprintf(filename, "cilkprof_speedup_%d.csv", TOOL_PRINT_NUM);
+  FILE *fout = fopen(filename, "w");
+  fprintf(fout, "file, line, call sites (rip), function type, workers, ");
+  fprintf(fout, "work, span, upper bound speedup, greedy lower bound speedup");
+  WHEN_BURDENED_SPAN( fprintf(fout, ", burdened span, burdened speedup estimate"); );
+  fprintf(fout, " \n");
+
+  print_speedup_rows(fout, "\"\", 0, 0x0, program, ", max_workers,
+                     work, span, burdened_span);
+
+  for (size_t i = 0; i < (1 << (call_site_table->lg_capacity)); ++i) {
+    for (iaddr_record_t *record = call_site_table->records[i];
+         NULL != record; record = record->next) {
+      if (record->index >= (1 << work_table->lg_capacity))
+        continue;
+      const cc_hashtable_entry_t *entry = &(work_table->entries[ record->index ]);
+      if (empty_cc_entry_p(work_table, entry) || 0 == entry->top_count)
+        continue;
+
+      int line = 0;
+      char *fstr = NULL;
+      uint64_t addr = rip2cc(record->iaddr);
+      char *line_to_free = get_info_on_inst_addr(addr, &line, &fstr);
+      snprintf(prefix, sizeof(prefix), "\"%s\", %d, 0x%lx, %s, ",
+               basename(fstr), line, addr, FunctionType_str[record->func_type]);
+      if (line_to_free) free(line_to_free);
+
+      uint64_t top_bspn = 0;
+      WHEN_BURDENED_SPAN( top_bspn = entry->top_bspn; );
+      print_speedup_rows(fout, prefix, max_workers,
+                         entry->top_wrk, entry->top_spn, top_bspn);
+    }
+  }
+  fclose(fout);
+}
+
+#if CRITICAL_PATH
+// Print one row of the critical path for a segment in call site
+// cs_index.
+static void print_critical_path_segment(FILE *fout, const iaddr_record_t *record,
+                                        int segment, uint64_t length,
+                                        uint64_t cumulative, uint64_t span) {
+  int line = 0;
+  char *fstr = NULL;
+  uint64_t addr = rip2cc(record->iaddr);
+  char *line_to_free = get_info_on_inst_addr(addr, &line, &fstr);
+  fprintf(fout, "%d, \"%s\", %d, 0x%lx, %s, %lu, %lu, %g\n",
+          segment, (NULL != fstr) ? basename(fstr) : "??", line, addr,
+          FunctionType_str[record->func_type], length, cumulative,
+          (double)length / (double)span);
+  if (line_to_free) free(line_to_free);
+}
+
+// Print the critical path, the path prefix followed by the path contin,
+// to cilkprof_critical_path_N.csv as an ordered list of segments.
+// Adjacent segments in the same call site are printed as one.
+static void print_critical_path(const path_node_t *prefix,
+                                const path_node_t *contin) {
+  char filename[64];
+  sprintf(filename, "cilkprof_critical_path_%d.csv", TOOL_PRINT_NUM);
+  FILE *fout = fopen(filename, "w");
+  fprintf(fout, "segment, file, line, call sites (rip), function type, ");
+  fprintf(fout, "length, cumulative length, fraction of span \n");
+
+  // Map call-site indices back to their records.
+  const iaddr_record_t **records =
+      (const iaddr_record_t**)malloc(sizeof(iaddr_record_t*) * call_site_table->table_size);
+  for (size_t i = 0; i < (1 << (call_site_table->lg_capacity)); ++i) {
+    for (const iaddr_record_t *record = call_site_table->records[i];
+         NULL != record; record = record->next)
+      records[record->index] = record;
+  }
+
+  uint64_t span = ((NULL != prefix) ? prefix->length : 0)
+      + ((NULL != contin) ? contin->length : 0);
+  int segment = 0;
+  int32_t run_cs = -1;
+  uint64_t run_length = 0, cumulative = 0;
+  const path_node_t *parts[2] = { prefix, contin };
+  for (int p = 0; p < 2; ++p) {
+    path_iter_t iter;
+    int32_t cs_index;
+    uint64_t length;
+    path_iter_init(&iter, parts[p]);
+    while (path_iter_next(&iter, &cs_index, &length)) {
+      if (cs_index != run_cs && run_cs >= 0) {
+        cumulative += run_length;
+        print_critical_path_segment(fout, records[run_cs], segment++,
+                                    run_length, cumulative, span);
+        run_length = 0;
+      }
+      run_cs = cs_index;
+      run_length += length;
+    }
+    path_iter_free(&iter);
+  }
+  if (run_cs >= 0) {
+    cumulative += run_length;
+    print_critical_path_segment(fout, records[run_cs], segment++,
+                                run_length, cumulative, span);
+  }
+
+  free(records);
+  fclose(fout);
+}
+#endif
+
+static void free_regions(cilkprof_stack_t *stack) {
+  while (NULL != stack->region) {
+    region_frame_t *active = stack->region;
+    stack->region = active->parent;
+    free(active);
+  }
+  while (NULL != regions) {
+    cilkprof_region_t *region = regions;
+    regions = region->next;
+    free(region->name);
+    free_cc_hashtable(region->wrk_table);
+    free_cc_hashtable(region->spn_table);
+    free(region);
+  }
+  regions_tail = &regions;
+}
+
 /*************************************************************************/
 
 void cilk_tool_init(void) {
@@ -183,6 +928,10 @@ void cilk_tool_destroy(void) {
     // Print the output, if we haven't done so already
     if (!TOOL_PRINTED)
       cilk_tool_print();
+#if SNAPSHOTS
+    destroy_snapshots();
+#endif
+    free_regions(stack);
 
     /* cilkprof_stack_frame_t *old_bottom = cilkprof_stack_pop(stack); */
     cilkprof_stack_frame_t *old_bottom = stack->bot;
@@ -195,10 +944,19 @@ void cilk_tool_destroy(void) {
 #endif
     free_cc_hashtable(stack->wrk_table);
 #if COMPUTE_STRAND_DATA
-    free_strand_hashtable(stack->strand_wrk_table);
+    free_cc_hashtable(stack->strand_wrk_table);
 #endif
-    old_bottom->parent = stack->helper_sf_free_list;
-    stack->helper_sf_free_list = old_bottom;
+    // The bottom frame was allocated by cilkprof_stack_init, rather
+    // than carved from a slab.
+    free_cc_hashtable(old_bottom->prefix_table);
+    free_cc_hashtable(old_bottom->lchild_table);
+    free_cc_hashtable(old_bottom->contin_table);
+#if COMPUTE_STRAND_DATA
+    free_cc_hashtable(old_bottom->strand_prefix_table);
+    free_cc_hashtable(old_bottom->strand_lchild_table);
+    free_cc_hashtable(old_bottom->strand_contin_table);
+#endif
+    free(old_bottom);
 
     // Actually free the entries of the free lists
     /* c_fn_frame_t *c_fn_frame = stack->c_fn_free_list; */
@@ -221,11 +979,10 @@ void cilk_tool_destroy(void) {
       /* free_cc_hashtable(free_frame->lchild_table); */
       /* free_cc_hashtable(free_frame->contin_table); */
 #if COMPUTE_STRAND_DATA
-      free_strand_hashtable(free_frame->strand_prefix_table);
-      /* free_strand_hashtable(free_frame->strand_lchild_table); */
-      /* free_strand_hashtable(free_frame->strand_contin_table); */
+      free_cc_hashtable(free_frame->strand_prefix_table);
+      /* free_cc_hashtable(free_frame->strand_lchild_table); */
+      /* free_cc_hashtable(free_frame->strand_contin_table); */
 #endif
-      free(free_frame);
       free_frame = next_free_frame;
     }
     stack->helper_sf_free_list = NULL;
@@ -239,32 +996,35 @@ void cilk_tool_destroy(void) {
       free_cc_hashtable(free_frame->lchild_table);
       free_cc_hashtable(free_frame->contin_table);
 #if COMPUTE_STRAND_DATA
-      free_strand_hashtable(free_frame->strand_lchild_table);
-      free_strand_hashtable(free_frame->strand_contin_table);
+      free_cc_hashtable(free_frame->strand_lchild_table);
+      free_cc_hashtable(free_frame->strand_contin_table);
 #endif
-      free(free_frame);
       free_frame = next_free_frame;
     }
     stack->spawner_sf_free_list = NULL;
+    cilkprof_stack_free_slabs(stack);
+    cc_hashtable_pool_free();
 
     free(stack->cs_status);
     free(stack->fn_status);
     free(stack->c_stack);
-
-    cc_hashtable_list_el_t *free_list_el = ll_free_list;
-    cc_hashtable_list_el_t *next_free_list_el;
-    while (NULL != free_list_el) {
-      next_free_list_el = free_list_el->next;
-      free(free_list_el);
-      free_list_el = next_free_list_el;
-    }
-    ll_free_list = NULL;
+#if CRITICAL_PATH
+    // Paths still held by the stack are freed with their pool.
+    path_pool_free();
+#endif
+#if COLLAPSE_SHORT_CALLS
+    free(stack->collapsed_cs);
+#endif
 
     // Free the tables of call sites and functions
     iaddr_table_free(call_site_table);
     call_site_table = NULL;
     iaddr_table_free(function_table);
     function_table = NULL;
+#if COMPUTE_STRAND_DATA
+    strand_id_table_free(strand_id_table);
+    strand_id_table = NULL;
+#endif
 
     TOOL_INITIALIZED = false;
   }
@@ -287,12 +1047,29 @@ void cilk_tool_print(void) {
   /* assert(NULL == stack->bot->c_fn_frame->parent); */
   assert(stack->bot->c_head == stack->c_tail);
 
+#if SNAPSHOTS
+  // Take a final snapshot, so that the deltas over all snapshots sum
+  // to the totals reported below.
+  if (NULL != snapshot_fout || snapshot_timer_created)
+    take_snapshot(stack);
+#endif
+
   cilkprof_stack_frame_t *bottom = stack->bot;
   c_fn_frame_t *c_bottom = &(stack->c_stack[stack->c_tail]);
 
   /* uint64_t span = stack->bot->prefix_spn + stack->bot->c_fn_frame->running_spn; */
   uint64_t span = bottom->prefix_spn + c_bottom->running_spn
       + bottom->local_spn + bottom->local_contin;
+#if BURDENED_SPAN
+  uint64_t burdened_span = bottom->prefix_bspn + c_bottom->running_bspn
+      + bottom->contin_bspn;
+#endif
+#if STRAND_PERF
+  strand_counters_t span_ctr = bottom->prefix_spn_ctr;
+  add_strand_counters(&span_ctr, &(c_bottom->running_spn_ctr));
+  add_strand_counters(&span_ctr, &(bottom->local_spn_ctr));
+  add_strand_counters(&span_ctr, &(bottom->local_contin_ctr));
+#endif
 
   add_cc_hashtables(&(bottom->prefix_table), &(bottom->contin_table));
   clear_cc_hashtable(bottom->contin_table);
@@ -302,174 +1079,73 @@ void cilk_tool_print(void) {
   cc_hashtable_t* span_table = bottom->prefix_table;
 /* #if PRINT_RES */
 /*   fprintf(stderr, */
-/*           "span_table->list_size = %d, span_table->table_size = %d, span_table->lg_capacity = %d\n", */
-/*   	  span_table->list_size, span_table->table_size, span_table->lg_capacity); */
+/*           "span_table->log_size = %d, span_table->table_size = %d, span_table->lg_capacity = %d\n", */
+/*   	  span_table->log_size, span_table->table_size, span_table->lg_capacity); */
 /* #endif */
 
   /* uint64_t work = stack->bot->c_fn_frame->running_wrk; */
   uint64_t work = c_bottom->running_wrk + c_bottom->local_wrk;
+#if STRAND_PERF
+  strand_counters_t work_ctr = c_bottom->running_wrk_ctr;
+  add_strand_counters(&work_ctr, &(c_bottom->local_wrk_ctr));
+#endif
   flush_cc_hashtable(&(stack->wrk_table));
   cc_hashtable_t* work_table = stack->wrk_table;
 /* #if PRINT_RES */
 /*   fprintf(stderr, */
-/*           "work_table->list_size = %d, work_table->table_size = %d, work_table->lg_capacity = %d\n", */
-/*   	  work_table->list_size, work_table->table_size, work_table->lg_capacity); */
+/*           "work_table->log_size = %d, work_table->table_size = %d, work_table->lg_capacity = %d\n", */
+/*   	  work_table->log_size, work_table->table_size, work_table->lg_capacity); */
 /* #endif */
 
   // Read the proc maps list
   read_proc_maps();
 
-  // Open call site CSV
-  sprintf(filename, "cilkprof_cs_%d.csv", TOOL_PRINT_NUM);
-  fout = fopen(filename, "w"); 
-
-  // print the header for the csv file
-  /* fprintf(fout, "file, line, call sites (rip), depth, "); */
-  fprintf(fout, "file, line, call sites (rip), function type, ");
-  fprintf(fout, "work on work, span on work, parallelism on work, count on work, ");
-  fprintf(fout, "top work on work, top span on work, top parallelism on work, top count on work, ");
-  fprintf(fout, "local work on work, local span on work, local parallelism on work, local count on work, ");
-  fprintf(fout, "work on span, span on span, parallelism on span, count on span, ");
-  fprintf(fout, "top work on span, top span on span, top parallelism on span, top count on span, ");
-  fprintf(fout, "local work on span, local span on span, local parallelism on span, local count on span \n");
-
-  // Parse tables
-  int span_table_entries_read = 0;
-  for (size_t i = 0; i < (1 << (call_site_table->lg_capacity)); ++i) {
-    iaddr_record_t *record = call_site_table->records[i];
-    /* fprintf(stderr, "\n"); */
-    while (NULL != record /* && (uintptr_t)NULL != record->iaddr */) {
-      /* fprintf(stderr, "rip %p (%d), ", record->iaddr, record->index); */
-
-      assert(0 != record->iaddr);
-      assert(0 <= record->index && record->index < (1 << work_table->lg_capacity));
-
-      cc_hashtable_entry_t *entry = &(work_table->entries[ record->index ]);
-      /* fprintf(stderr, "%p\n", entry->rip); */
-      /* if (entry->rip != record->iaddr) { */
-      if (empty_cc_entry_p(entry)) {
-        record = record->next;
-        continue;
-      }
-
-      assert(entry->rip == record->iaddr);
-
-      uint64_t wrk_wrk = entry->wrk;
-      uint64_t spn_wrk = entry->spn;
-      double par_wrk = (double)wrk_wrk/(double)spn_wrk;
-      uint64_t cnt_wrk = entry->count;
-
-      uint64_t t_wrk_wrk = entry->top_wrk;
-      uint64_t t_spn_wrk = entry->top_spn;
-      double t_par_wrk = (double)t_wrk_wrk/(double)t_spn_wrk;
-      uint64_t t_cnt_wrk = entry->top_count;
-
-      uint64_t l_wrk_wrk = entry->local_wrk;
-      uint64_t l_spn_wrk = entry->local_spn;
-      double l_par_wrk = (double)l_wrk_wrk/(double)l_spn_wrk;
-      uint64_t l_cnt_wrk = entry->local_count;
-
-      uint64_t wrk_spn = 0;
-      uint64_t spn_spn = 0;
-      double par_spn = DBL_MAX;
-      uint64_t cnt_spn = 0;
-
-      uint64_t t_wrk_spn = 0;
-      uint64_t t_spn_spn = 0;
-      double t_par_spn = DBL_MAX;
-      uint64_t t_cnt_spn = 0;
-
-      uint64_t l_wrk_spn = 0;
-      uint64_t l_spn_spn = 0;
-      double l_par_spn = DBL_MAX;
-      uint64_t l_cnt_spn = 0;
-
-      if (record->index < (1 << span_table->lg_capacity)) {
-        cc_hashtable_entry_t *st_entry = &(span_table->entries[ record->index ]);
-
-        if (!empty_cc_entry_p(st_entry)) {
-          assert(st_entry->rip == entry->rip);
-
-          wrk_spn = st_entry->wrk;
-          spn_spn = st_entry->spn;
-          par_spn = (double)wrk_spn / (double)spn_spn;
-          cnt_spn = st_entry->count;
-
-          t_wrk_spn = st_entry->top_wrk;
-          t_spn_spn = st_entry->top_spn;
-          t_par_spn = (double)t_wrk_spn / (double)t_spn_spn;
-          t_cnt_spn = st_entry->top_count;
-
-          l_wrk_spn = st_entry->local_wrk;
-          l_spn_spn = st_entry->local_spn;
-          l_par_spn = (double)l_wrk_spn / (double)l_spn_spn;
-          l_cnt_spn = st_entry->local_count;
+  int output_formats = read_output_formats();
+  if (output_formats & OUTPUT_CSV) {
+    // Open call site CSV
+    sprintf(filename, "cilkprof_cs_%d.csv", TOOL_PRINT_NUM);
+    fout = fopen(filename, "w");
 
-          ++span_table_entries_read;
-        }
-      }
+    print_call_site_csv(fout, stack, work_table, span_table);
+    fclose(fout);
+  }
+  if (output_formats & OUTPUT_PPROF) {
+    sprintf(filename, "cilkprof_%d.pb", TOOL_PRINT_NUM);
+    fout = fopen(filename, "w");
+    print_call_site_pprof(fout, stack, work_table, span_table);
+    fclose(fout);
+  }
+  if (output_formats & OUTPUT_SPEEDSCOPE) {
+    sprintf(filename, "cilkprof_%d.speedscope.json", TOOL_PRINT_NUM);
+    fout = fopen(filename, "w");
+    print_call_site_speedscope(fout, stack, work_table, span_table);
+    fclose(fout);
+  }
 
-      int line = 0; 
-      char *fstr = NULL;
-      /* uint64_t addr = rip2cc(entry->rip); */
-      uint64_t addr = rip2cc(record->iaddr);
+  if (NULL != regions)
+    print_regions(stack);
 
-      // get_info_on_inst_addr returns a char array from some system call that
-      // needs to get freed by the user after we are done with the info
-      char *line_to_free = get_info_on_inst_addr(addr, &line, &fstr);
-      char *file = basename(fstr);
-      /* fprintf(fout, "\"%s\", %d, 0x%lx, %d, ", file, line, addr, entry->depth); */
-      fprintf(fout, "\"%s\", %d, 0x%lx, ", file, line, addr);
-      /* if (entry->is_recursive) {  // recursive function */
-      /* if (entry->func_type & IS_RECURSIVE) {  // recursive function */
-      /* FunctionType_t func_type = (stack->cs_status[record->index].func_type & ~ON_STACK); */
-      FunctionType_t func_type = record->func_type;
-      if (stack->cs_status[record->index].flags & RECURSIVE) {  // recursive function
-        fprintf(fout, "%s %s, ",
-                FunctionType_str[func_type],
-                FunctionType_str[IS_RECURSIVE]);
-      } else {
-        fprintf(fout, "%s, ", FunctionType_str[func_type]);
-      }
-      fprintf(fout, "%lu, %lu, %g, %lu, %lu, %lu, %g, %lu, %lu, %lu, %g, %lu, ", 
-              wrk_wrk, spn_wrk, par_wrk, cnt_wrk,
-              t_wrk_wrk, t_spn_wrk, t_par_wrk, t_cnt_wrk,
-              l_wrk_wrk, l_spn_wrk, l_par_wrk, l_cnt_wrk);
-      fprintf(fout, "%lu, %lu, %g, %lu, %lu, %lu, %g, %lu, %lu, %lu, %g, %lu\n", 
-              wrk_spn, spn_spn, par_spn, cnt_spn,
-              t_wrk_spn, t_spn_spn, t_par_spn, t_cnt_spn,
-              l_wrk_spn, l_spn_spn, l_par_spn, l_cnt_spn);
-      if(line_to_free) free(line_to_free);
-      
-      record = record->next;
-    }
-  }
-  fclose(fout);
+  uint64_t bspan = 0;
+  WHEN_BURDENED_SPAN( bspan = burdened_span; );
+  print_speedup_csv(stack, work_table, work, span, bspan);
 
-  /* if (span_table_entries_read != span_table->table_size) { */
-  /*   fprintf(stderr, "read %d, table contains %d\n", */
-  /*           span_table_entries_read, span_table->table_size); */
-  /* } */
-  assert(span_table_entries_read == span_table->table_size);
+#if CRITICAL_PATH
+  assert(span == ((NULL != bottom->prefix_path) ? bottom->prefix_path->length : 0)
+         + ((NULL != c_bottom->path) ? c_bottom->path->length : 0));
+  print_critical_path(bottom->prefix_path, c_bottom->path);
+#endif
 
 #if COMPUTE_STRAND_DATA
   // Strand tables
-  add_strand_hashtables(&(stack->bot->strand_prefix_table), &(stack->bot->strand_contin_table));
-  clear_strand_hashtable(stack->bot->strand_contin_table);
+  add_cc_hashtables(&(stack->bot->strand_prefix_table), &(stack->bot->strand_contin_table));
+  clear_cc_hashtable(stack->bot->strand_contin_table);
 
-  flush_strand_hashtable(&(stack->bot->strand_prefix_table));
+  flush_cc_hashtable(&(stack->bot->strand_prefix_table));
 
-  strand_hashtable_t* strand_span_table = stack->bot->strand_prefix_table;
-  fprintf(stderr, 
-          "strand_span_table->list_size = %d, strand_span_table->table_size = %d, strand_span_table->lg_capacity = %d\n",
-  	  strand_span_table->list_size, strand_span_table->table_size, strand_span_table->lg_capacity);
+  cc_hashtable_t* strand_span_table = stack->bot->strand_prefix_table;
 
-
-  flush_strand_hashtable(&(stack->strand_wrk_table));
-  strand_hashtable_t* strand_work_table = stack->strand_wrk_table;
-  fprintf(stderr, 
-          "strand_work_table->list_size = %d, strand_work_table->table_size = %d, strand_work_table->lg_capacity = %d\n",
-  	  strand_work_table->list_size, strand_work_table->table_size, strand_work_table->lg_capacity);
+  flush_cc_hashtable(&(stack->strand_wrk_table));
+  cc_hashtable_t* strand_work_table = stack->strand_wrk_table;
 
   // Open strand CSV
   sprintf(filename, "cilkprof_strand_%d.csv", TOOL_PRINT_NUM);
@@ -482,34 +1158,38 @@ void cilk_tool_print(void) {
   fprintf(fout, "work on span, count on span \n");
 
   // Parse tables
-  span_table_entries_read = 0;
-  for (size_t i = 0; i < (1 << strand_work_table->lg_capacity); ++i) {
-    strand_hashtable_entry_t *entry = &(strand_work_table->entries[i]);
-    /* fprintf(stderr, "entry->start %lx, entry->end %lx\n", */
-    /*         entry->start, entry->end); */
-    if (!empty_strand_entry_p(entry)) {
-      uint64_t wrk_wrk = entry->wrk;
-      uint64_t on_wrk_cnt = entry->count;
+  int span_table_entries_read = 0;
+  for (int32_t i = 0; i < strand_id_table->table_size; ++i) {
+    const strand_endpoints_t *strand = &(strand_id_table->strands[i]);
+    if (i >= (1 << strand_work_table->lg_capacity))
+      break;
+    cc_hashtable_entry_t *entry = &(strand_work_table->entries[i]);
+    /* fprintf(stderr, "strand->start %lx, strand->end %lx\n", */
+    /*         strand->start, strand->end); */
+    if (!empty_cc_entry_p(strand_work_table, entry)) {
+      uint64_t wrk_wrk = entry->local_wrk;
+      uint64_t on_wrk_cnt = entry->local_count;
       uint64_t wrk_spn = 0;
       uint64_t on_spn_cnt = 0;
 
-      strand_hashtable_entry_t *st_entry = 
-          get_strand_hashtable_entry_const(entry->start, entry->end, strand_span_table);
-      if(st_entry && !empty_strand_entry_p(st_entry)) {
-	  ++span_table_entries_read;
-          wrk_spn = st_entry->wrk;
-          on_spn_cnt = st_entry->count;
+      if (i < (1 << strand_span_table->lg_capacity)) {
+        cc_hashtable_entry_t *st_entry = &(strand_span_table->entries[i]);
+        if (!empty_cc_entry_p(strand_span_table, st_entry)) {
+          ++span_table_entries_read;
+          wrk_spn = st_entry->local_wrk;
+          on_spn_cnt = st_entry->local_count;
+        }
       }
 
 #if OLD_PRINTOUT
-      fprintf(stdout, "%lx:%lx ", rip2cc(entry->start), rip2cc(entry->end));
+      fprintf(stdout, "%lx:%lx ", rip2cc(strand->start), rip2cc(strand->end));
       fprintf(stdout, " %lu %lu\n",
 	      wrk_wrk, wrk_spn);
 #endif
       int line = 0; 
       char *fstr = NULL;
-      uint64_t start_addr = rip2cc(entry->start);
-      uint64_t end_addr = rip2cc(entry->end);
+      uint64_t start_addr = rip2cc(strand->start);
+      uint64_t end_addr = rip2cc(strand->end);
 
       // get_info_on_inst_addr returns a char array from some system call that
       // needs to get freed by the user after we are done with the info
@@ -532,6 +1212,15 @@ void cilk_tool_print(void) {
 
 #if PRINT_RES
   print_work_span(work, span);
+  WHEN_BURDENED_SPAN( fprintf(stderr, "burdened span %lu, burdened parallelism %f\n",
+                              burdened_span, work / (float)burdened_span); );
+  WHEN_STRAND_PERF( print_counters_work_span(&work_ctr, &span_ctr); );
+  WHEN_CALIBRATE_OVERHEAD( fprintf(stderr, "hook overhead %lu +/- %lu %s per strand, "
+                                   "removed from %lu strands, work error +/- %lu %s\n",
+                                   STRAND_OVERHEAD.per_strand, STRAND_OVERHEAD.error,
+                                   STRAND_UNIT, stack->num_strands,
+                                   stack->num_strands * STRAND_OVERHEAD.error,
+                                   STRAND_UNIT); );
 #endif
 
   /*
@@ -539,22 +1228,14 @@ void cilk_tool_print(void) {
   fprintf(stderr, "Dumping span table:\n");
   for (size_t j = 0; j < (1 << span_table->lg_capacity); ++j) {
     cc_hashtable_entry_t *st_entry = &(span_table->entries[j]);
-    if (empty_cc_entry_p(st_entry)) {
+    if (empty_cc_entry_p(span_table, st_entry)) {
       continue;
     }
     fprintf(stderr, "entry %zu: rip %lx, depth %d\n", j, rip2cc(st_entry->rip), st_entry->depth);
   } */
 
   // Free the proc maps list
-  mapping_list_el_t *map_lst_el = maps.head;
-  mapping_list_el_t *next_map_lst_el;
-  while (NULL != map_lst_el) {
-    next_map_lst_el = map_lst_el->next;
-    free(map_lst_el);
-    map_lst_el = next_map_lst_el;
-  }
-  maps.head = NULL;
-  maps.tail = NULL;
+  free_proc_maps();
 
   TOOL_PRINTED = true;
   ++TOOL_PRINT_NUM;
@@ -588,6 +1269,8 @@ void cilk_enter_begin(uint32_t prop, __cilkrts_stack_frame *sf, void* this_fn, v
     uint64_t strand_len = measure_and_add_strand_length(stack);
     if (stack->bot->c_head == stack->c_tail) {
       stack->bot->local_contin += strand_len;
+      WHEN_STRAND_PERF( add_strand_counters(&(stack->bot->local_contin_ctr),
+                                            &(stack->strand_ruler.counts)); );
     }
     stack->in_user_code = false;
   }
@@ -661,6 +1344,8 @@ void cilk_enter_helper_begin(__cilkrts_stack_frame *sf, void *this_fn, void *rip
 
   uint64_t strand_len = measure_and_add_strand_length(stack);
   stack->bot->local_contin += strand_len;
+  WHEN_STRAND_PERF( add_strand_counters(&(stack->bot->local_contin_ctr),
+                                        &(stack->strand_ruler.counts)); );
 
   stack->in_user_code = false;
 
@@ -780,6 +1465,17 @@ void cilk_tool_c_function_enter(uint32_t prop, void *this_fn, void *rip)
                                 __builtin_extract_return_addr(__builtin_return_address(0))); );
     }
     assert(stack->in_user_code);
+
+#if COLLAPSE_SHORT_CALLS
+    // A call from a collapsed call site runs as part of the current
+    // strand.
+    uintptr_t collapse_cs = (uintptr_t)__builtin_extract_return_addr(rip);
+    if (stack->collapsed_cs[collapsed_cs_slot(collapse_cs)] == collapse_cs) {
+      ++stack->c_stack[stack->c_tail].collapsed_calls;
+      return;
+    }
+#endif
+
 #if COMPUTE_STRAND_DATA
     stack->strand_end
         = (uintptr_t)__builtin_extract_return_addr(__builtin_return_address(0));
@@ -788,6 +1484,8 @@ void cilk_tool_c_function_enter(uint32_t prop, void *this_fn, void *rip)
     uint64_t strand_len = measure_and_add_strand_length(stack);
     if (stack->bot->c_head == stack->c_tail) {
       stack->bot->local_contin += strand_len;
+      WHEN_STRAND_PERF( add_strand_counters(&(stack->bot->local_contin_ctr),
+                                            &(stack->strand_ruler.counts)); );
     }
 
     // Push new frame for this C function onto the stack
@@ -802,6 +1500,12 @@ void cilk_tool_c_function_enter(uint32_t prop, void *this_fn, void *rip)
     if (cs_index >= stack->cs_status_capacity) {
       resize_cs_status_vector(&(stack->cs_status), &(stack->cs_status_capacity));
     }
+#if COLLAPSE_SHORT_CALLS
+    // Collapse later calls from this call site, if it was collapsed
+    // since its last call or was evicted from the cache.
+    if (stack->cs_status[cs_index].flags & COLLAPSED)
+      stack->collapsed_cs[collapsed_cs_slot(cs)] = cs;
+#endif
     int32_t cs_tail = stack->cs_status[cs_index].c_tail;
     if (OFF_STACK != cs_tail) {
       if (!(stack->cs_status[cs_index].flags & RECURSIVE)) {
@@ -853,6 +1557,14 @@ void cilk_tool_c_function_leave(void *rip)
 
   cilkprof_stack_t *stack = &(GET_STACK(ctx_stack));
 
+#if COLLAPSE_SHORT_CALLS
+  if (TOOL_INITIALIZED && stack->c_stack[stack->c_tail].collapsed_calls > 0) {
+    // Return from a collapsed call
+    --stack->c_stack[stack->c_tail].collapsed_calls;
+    return;
+  }
+#endif
+
   const c_fn_frame_t *c_bottom = &(stack->c_stack[stack->c_tail]);
   if (NULL != stack->bot &&
       MAIN == stack->bot->func_type &&
@@ -901,8 +1613,8 @@ void cilk_tool_c_function_leave(void *rip)
 /*   assert(cc_hashtable_is_empty(stack->bot->prefix_table)); */
 /*   assert(cc_hashtable_is_empty(stack->bot->lchild_table)); */
 /* #if COMPUTE_STRAND_DATA */
-/*   assert(strand_hashtable_is_empty(stack->bot->strand_prefix_table)); */
-/*   assert(strand_hashtable_is_empty(stack->bot->strand_lchild_table)); */
+/*   assert(cc_hashtable_is_empty(stack->bot->strand_prefix_table)); */
+/*   assert(cc_hashtable_is_empty(stack->bot->strand_lchild_table)); */
 /* #endif */
 
   // Pop the stack
@@ -911,11 +1623,26 @@ void cilk_tool_c_function_leave(void *rip)
   uint64_t local_wrk = old_bottom->local_wrk;
   uint64_t running_wrk = old_bottom->running_wrk + local_wrk;
   uint64_t running_spn = old_bottom->running_spn + local_wrk;
+#if BURDENED_SPAN
+  uint64_t running_bspn = old_bottom->running_bspn + local_wrk;
+#endif
+#if STRAND_PERF
+  strand_counters_t running_wrk_ctr = old_bottom->running_wrk_ctr;
+  add_strand_counters(&running_wrk_ctr, &(old_bottom->local_wrk_ctr));
+  strand_counters_t running_spn_ctr = old_bottom->running_spn_ctr;
+  add_strand_counters(&running_spn_ctr, &(old_bottom->local_wrk_ctr));
+#endif
 
   int32_t cs_index = old_bottom->cs_index;
   int32_t cs_tail = stack->cs_status[cs_index].c_tail;
   bool top_cs = (cs_tail == stack->c_tail + 1);
 
+#if COLLAPSE_SHORT_CALLS
+  // Calls are only observed while strands are measured.
+  if (!REGIONS_ONLY || NULL != stack->region)
+    observe_call_length(&(stack->cs_status[cs_index]), old_bottom);
+#endif
+
   /* fprintf(stderr, "cs_index = %d\n", cs_index); */
   if (top_cs) {  // top CS instance
     stack->cs_status[cs_index].c_tail = OFF_STACK;
@@ -928,6 +1655,10 @@ void cilk_tool_c_function_leave(void *rip)
   c_fn_frame_t *new_bottom = &(stack->c_stack[stack->c_tail]);
   new_bottom->running_wrk += running_wrk;
   new_bottom->running_spn += running_spn;
+  WHEN_CRITICAL_PATH( new_bottom->path = path_concat(new_bottom->path, old_bottom->path); );
+  WHEN_BURDENED_SPAN( new_bottom->running_bspn += running_bspn; );
+  WHEN_STRAND_PERF( add_strand_counters(&(new_bottom->running_wrk_ctr), &running_wrk_ctr);
+                    add_strand_counters(&(new_bottom->running_spn_ctr), &running_spn_ctr); );
 
   // TB: This assert can fail if the compiler does really aggressive
   // inlining.  See bfs compiled with -O3.
@@ -951,6 +1682,15 @@ void cilk_tool_c_function_leave(void *rip)
                                       cs_index,
 #ifndef NDEBUG
                                       old_bottom->rip,
+#endif
+#if STRAND_PERF
+                                      &running_wrk_ctr,
+                                      &running_spn_ctr,
+                                      &(old_bottom->local_wrk_ctr),
+                                      &(old_bottom->local_wrk_ctr),
+#endif
+#if BURDENED_SPAN
+                                      running_bspn,
 #endif
                                       running_wrk,
                                       running_spn,
@@ -963,6 +1703,15 @@ void cilk_tool_c_function_leave(void *rip)
                                       cs_index,
 #ifndef NDEBUG
                                       old_bottom->rip,
+#endif
+#if STRAND_PERF
+                                      &running_wrk_ctr,
+                                      &running_spn_ctr,
+                                      &(old_bottom->local_wrk_ctr),
+                                      &(old_bottom->local_wrk_ctr),
+#endif
+#if BURDENED_SPAN
+                                      running_bspn,
 #endif
                                       running_wrk,
                                       running_spn,
@@ -976,6 +1725,10 @@ void cilk_tool_c_function_leave(void *rip)
                                             cs_index,
 #ifndef NDEBUG
                                             old_bottom->rip,
+#endif
+#if STRAND_PERF
+                                            &(old_bottom->local_wrk_ctr),
+                                            &(old_bottom->local_wrk_ctr),
 #endif
                                             local_wrk,
                                             local_wrk);
@@ -985,6 +1738,10 @@ void cilk_tool_c_function_leave(void *rip)
                                             cs_index,
 #ifndef NDEBUG
                                             old_bottom->rip,
+#endif
+#if STRAND_PERF
+                                            &(old_bottom->local_wrk_ctr),
+                                            &(old_bottom->local_wrk_ctr),
 #endif
                                             local_wrk,
                                             local_wrk);
@@ -996,9 +1753,9 @@ void cilk_tool_c_function_leave(void *rip)
 /*   clear_cc_hashtable(old_bottom->contin_table); */
 /*   clear_cc_hashtable(old_bottom->lchild_table); */
 /* #if COMPUTE_STRAND_DATA */
-/*   clear_strand_hashtable(old_bottom->strand_prefix_table); */
-/*   clear_strand_hashtable(old_bottom->strand_contin_table); */
-/*   clear_strand_hashtable(old_bottom->strand_lchild_table); */
+/*   clear_cc_hashtable(old_bottom->strand_prefix_table); */
+/*   clear_cc_hashtable(old_bottom->strand_contin_table); */
+/*   clear_cc_hashtable(old_bottom->strand_lchild_table); */
 /* #endif */
   /* free(old_bottom); */
   /* old_bottom->parent = stack->c_fn_free_list; */
@@ -1028,6 +1785,8 @@ void cilk_spawn_prepare(__cilkrts_stack_frame *sf)
 #endif
   uint64_t strand_len = measure_and_add_strand_length(stack);
   stack->bot->local_contin += strand_len;
+  WHEN_STRAND_PERF( add_strand_counters(&(stack->bot->local_contin_ctr),
+                                        &(stack->strand_ruler.counts)); );
 
   assert(stack->c_tail == stack->bot->c_head);
 
@@ -1052,8 +1811,6 @@ void cilk_spawn_or_continue(int in_continuation)
                 __builtin_extract_return_addr(__builtin_return_address(0))); );
     stack->in_user_code = true;
 
-    stack->bot->local_contin += BURDENING;
-
 #if COMPUTE_STRAND_DATA
     stack->strand_start
       = (uintptr_t)__builtin_extract_return_addr(__builtin_return_address(0));
@@ -1092,6 +1849,8 @@ void cilk_detach_begin(__cilkrts_stack_frame *parent)
 #endif
   uint64_t strand_len = measure_and_add_strand_length(stack);
   stack->bot->local_contin += strand_len;
+  WHEN_STRAND_PERF( add_strand_counters(&(stack->bot->local_contin_ctr),
+                                        &(stack->strand_ruler.counts)); );
 
   assert(stack->bot->c_head == stack->c_tail);
 
@@ -1133,6 +1892,8 @@ void cilk_sync_begin(__cilkrts_stack_frame *sf)
 #endif
   uint64_t strand_len = measure_and_add_strand_length(stack);
   stack->bot->local_contin += strand_len;
+  WHEN_STRAND_PERF( add_strand_counters(&(stack->bot->local_contin_ctr),
+                                        &(stack->strand_ruler.counts)); );
 
   assert(stack->bot->c_head == stack->c_tail);
 
@@ -1167,11 +1928,16 @@ void cilk_sync_end(__cilkrts_stack_frame *sf)
   /* if (stack->bot->lchild_spn > stack->bot->contin_spn) { */
   if (stack->bot->lchild_spn > c_bottom->running_spn + stack->bot->local_contin) {
     stack->bot->prefix_spn += stack->bot->lchild_spn;
+    WHEN_STRAND_PERF( add_strand_counters(&(stack->bot->prefix_spn_ctr),
+                                          &(stack->bot->lchild_spn_ctr)); );
+    WHEN_CRITICAL_PATH( stack->bot->prefix_path = path_concat(stack->bot->prefix_path,
+                                                              stack->bot->lchild_path);
+                        path_free(c_bottom->path); );
     // local_spn does not increase, because critical path goes through
     // spawned child.
     add_cc_hashtables(&(stack->bot->prefix_table), &(stack->bot->lchild_table));
 #if COMPUTE_STRAND_DATA
-    add_strand_hashtables(&(stack->bot->strand_prefix_table), &(stack->bot->strand_lchild_table));
+    add_cc_hashtables(&(stack->bot->strand_prefix_table), &(stack->bot->strand_lchild_table));
 #endif
   } else {
     /* stack->bot->prefix_spn += stack->bot->contin_spn; */
@@ -1179,21 +1945,47 @@ void cilk_sync_end(__cilkrts_stack_frame *sf)
     // critical path goes through continuation, which is local.  add
     // local_contin to local_spn.
     stack->bot->local_spn += stack->bot->local_contin;
+    WHEN_STRAND_PERF( add_strand_counters(&(stack->bot->prefix_spn_ctr),
+                                          &(c_bottom->running_spn_ctr));
+                      add_strand_counters(&(stack->bot->local_spn_ctr),
+                                          &(stack->bot->local_contin_ctr)); );
+    WHEN_CRITICAL_PATH( stack->bot->prefix_path = path_concat(stack->bot->prefix_path,
+                                                              c_bottom->path);
+                        path_free(stack->bot->lchild_path); );
     add_cc_hashtables(&(stack->bot->prefix_table), &(stack->bot->contin_table));
 #if COMPUTE_STRAND_DATA
-    add_strand_hashtables(&(stack->bot->strand_prefix_table), &(stack->bot->strand_contin_table));
+    add_cc_hashtables(&(stack->bot->strand_prefix_table), &(stack->bot->strand_contin_table));
 #endif
   }
+  WHEN_CRITICAL_PATH( stack->bot->lchild_path = NULL;
+                      c_bottom->path = NULL; );
+
+#if BURDENED_SPAN
+  uint64_t contin_bspn = c_bottom->running_bspn + stack->bot->contin_bspn;
+  if (0 != stack->bot->lchild_bspn) {
+    // Sync spawned children
+    stack->bot->prefix_bspn += SYNC_BURDEN +
+        ((stack->bot->lchild_bspn > contin_bspn) ? stack->bot->lchild_bspn : contin_bspn);
+  } else {
+    stack->bot->prefix_bspn += contin_bspn;
+  }
+  stack->bot->lchild_bspn = 0;
+  c_bottom->running_bspn = 0;
+  stack->bot->contin_bspn = 0;
+#endif
 
   // reset lchild and contin span variables
   stack->bot->lchild_spn = 0;
   c_bottom->running_spn = 0;
   stack->bot->local_contin = 0;
+  WHEN_STRAND_PERF( clear_strand_counters(&(stack->bot->lchild_spn_ctr));
+                    clear_strand_counters(&(c_bottom->running_spn_ctr));
+                    clear_strand_counters(&(stack->bot->local_contin_ctr)); );
   clear_cc_hashtable(stack->bot->lchild_table);
   clear_cc_hashtable(stack->bot->contin_table);
 #if COMPUTE_STRAND_DATA
-  clear_strand_hashtable(stack->bot->strand_lchild_table);
-  clear_strand_hashtable(stack->bot->strand_contin_table);
+  clear_cc_hashtable(stack->bot->strand_lchild_table);
+  clear_cc_hashtable(stack->bot->strand_contin_table);
 #endif
 
   /* fprintf(stderr, "local_wrk %lu, running_wrk %lu, local_spn %lu, prefix_spn %lu\n", */
@@ -1227,6 +2019,8 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
 #endif
   uint64_t strand_len = measure_and_add_strand_length(stack);
   stack->bot->local_contin += strand_len;
+  WHEN_STRAND_PERF( add_strand_counters(&(stack->bot->local_contin_ctr),
+                                        &(stack->strand_ruler.counts)); );
 
   assert(stack->in_user_code);
   stack->in_user_code = false;
@@ -1238,7 +2032,7 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
   if (SPAWNER == stack->bot->func_type) {
     assert(cc_hashtable_is_empty(stack->bot->lchild_table));
 #if COMPUTE_STRAND_DATA
-    assert(strand_hashtable_is_empty(stack->bot->strand_lchild_table));
+    assert(cc_hashtable_is_empty(stack->bot->strand_lchild_table));
 #endif
   } else {
     assert(NULL == stack->bot->lchild_table);
@@ -1251,9 +2045,21 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
   c_fn_frame_t *old_c_bottom = &(stack->c_stack[stack->c_tail]);
 
   stack->bot->prefix_spn += old_c_bottom->running_spn;
-  stack->bot->local_spn += stack->bot->local_contin + BURDENING;
+  stack->bot->local_spn += stack->bot->local_contin;
   old_c_bottom->running_wrk += old_c_bottom->local_wrk;
   stack->bot->prefix_spn += stack->bot->local_spn;
+  WHEN_CRITICAL_PATH( stack->bot->prefix_path = path_concat(stack->bot->prefix_path,
+                                                            old_c_bottom->path); );
+#if BURDENED_SPAN
+  assert(0 == stack->bot->lchild_bspn);
+  stack->bot->prefix_bspn += old_c_bottom->running_bspn + stack->bot->contin_bspn;
+#endif
+#if STRAND_PERF
+  add_strand_counters(&(stack->bot->prefix_spn_ctr), &(old_c_bottom->running_spn_ctr));
+  add_strand_counters(&(stack->bot->local_spn_ctr), &(stack->bot->local_contin_ctr));
+  add_strand_counters(&(old_c_bottom->running_wrk_ctr), &(old_c_bottom->local_wrk_ctr));
+  add_strand_counters(&(stack->bot->prefix_spn_ctr), &(stack->bot->local_spn_ctr));
+#endif
 
   if (SPAWNER == stack->bot->func_type) {
     assert(cc_hashtable_is_empty(stack->bot->contin_table));
@@ -1262,7 +2068,7 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
   }
 /*   add_cc_hashtables(&(stack->bot->prefix_table), &(stack->bot->contin_table)); */
 /* #if COMPUTE_STRAND_DATA */
-/*   add_strand_hashtables(&(stack->bot->strand_prefix_table), &(stack->bot->strand_contin_table)); */
+/*   add_cc_hashtables(&(stack->bot->strand_prefix_table), &(stack->bot->strand_contin_table)); */
 /* #endif */
 
   /* fprintf(stderr, "local_wrk %lu, running_wrk %lu, local_spn %lu, prefix_spn %lu\n", */
@@ -1286,6 +2092,8 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
   }
 
   c_bottom->running_wrk += old_c_bottom->running_wrk;
+  WHEN_STRAND_PERF( add_strand_counters(&(c_bottom->running_wrk_ctr),
+                                        &(old_c_bottom->running_wrk_ctr)); );
 
   // Update work table
   if (top_cs) {
@@ -1297,6 +2105,15 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
                                       cs_index,
 #ifndef NDEBUG
                                       old_c_bottom->rip,
+#endif
+#if STRAND_PERF
+                                      &(old_c_bottom->running_wrk_ctr),
+                                      &(old_bottom->prefix_spn_ctr),
+                                      &(old_c_bottom->local_wrk_ctr),
+                                      &(old_bottom->local_spn_ctr),
+#endif
+#if BURDENED_SPAN
+                                      old_bottom->prefix_bspn,
 #endif
                                       old_c_bottom->running_wrk,
                                       old_bottom->prefix_spn,
@@ -1309,6 +2126,15 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
                                       cs_index,
 #ifndef NDEBUG
                                       old_c_bottom->rip,
+#endif
+#if STRAND_PERF
+                                      &(old_c_bottom->running_wrk_ctr),
+                                      &(old_bottom->prefix_spn_ctr),
+                                      &(old_c_bottom->local_wrk_ctr),
+                                      &(old_bottom->local_spn_ctr),
+#endif
+#if BURDENED_SPAN
+                                      old_bottom->prefix_bspn,
 #endif
                                       old_c_bottom->running_wrk,
                                       old_bottom->prefix_spn,
@@ -1322,6 +2148,10 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
                                             cs_index,
 #ifndef NDEBUG
                                             old_c_bottom->rip,
+#endif
+#if STRAND_PERF
+                                            &(old_c_bottom->local_wrk_ctr),
+                                            &(old_bottom->local_spn_ctr),
 #endif
                                             old_c_bottom->local_wrk,
                                             old_bottom->local_spn);
@@ -1331,6 +2161,10 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
                                             cs_index,
 #ifndef NDEBUG
                                             old_c_bottom->rip,
+#endif
+#if STRAND_PERF
+                                            &(old_c_bottom->local_wrk_ctr),
+                                            &(old_bottom->local_spn_ctr),
 #endif
                                             old_c_bottom->local_wrk,
                                             old_bottom->local_spn);
@@ -1345,30 +2179,41 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
 
     // Update continuation variable
     c_bottom->running_spn += old_bottom->prefix_spn;
+    WHEN_CRITICAL_PATH( c_bottom->path = path_concat(c_bottom->path,
+                                                     old_bottom->prefix_path); );
+    WHEN_STRAND_PERF( add_strand_counters(&(c_bottom->running_spn_ctr),
+                                          &(old_bottom->prefix_spn_ctr)); );
+    WHEN_BURDENED_SPAN( c_bottom->running_bspn += old_bottom->prefix_bspn; );
     // Don't increment local_spn for new stack->bot.
     /* fprintf(stderr, "adding tables\n"); */
 
     assert(cc_hashtable_is_empty(old_bottom->contin_table));
     assert(cc_hashtable_is_empty(old_bottom->lchild_table));
 #if COMPUTE_STRAND_DATA
-    assert(cc_hashtable_is_empty(old_bottom->contin_table));
-    assert(cc_hashtable_is_empty(old_bottom->lchild_table));
+    assert(cc_hashtable_is_empty(old_bottom->strand_contin_table));
+    assert(cc_hashtable_is_empty(old_bottom->strand_lchild_table));
 #endif
     // Need to reassign pointers, in case of table resize.
     if (0 == stack->bot->lchild_spn) {
       stack->bot->prefix_table = old_bottom->prefix_table;
+#if COMPUTE_STRAND_DATA
+      stack->bot->strand_prefix_table = old_bottom->strand_prefix_table;
+#endif
       /* assert(stack->bot->prefix_table == old_bottom->prefix_table); */
       // No outstanding spawned children
 /*       add_cc_hashtables(&(stack->bot->prefix_table), &(old_bottom->prefix_table)); */
 /* #if COMPUTE_STRAND_DATA */
-/*       add_strand_hashtables(&(stack->bot->strand_prefix_table), &(old_bottom->strand_prefix_table)); */
+/*       add_cc_hashtables(&(stack->bot->strand_prefix_table), &(old_bottom->strand_prefix_table)); */
 /* #endif */
     } else {
       stack->bot->contin_table = old_bottom->prefix_table;
+#if COMPUTE_STRAND_DATA
+      stack->bot->strand_contin_table = old_bottom->strand_prefix_table;
+#endif
       /* assert(stack->bot->contin_table == old_bottom->prefix_table); */
 /*       add_cc_hashtables(&(stack->bot->contin_table), &(old_bottom->prefix_table)); */
 /* #if COMPUTE_STRAND_DATA */
-/*       add_strand_hashtables(&(stack->bot->strand_contin_table), &(old_bottom->strand_prefix_table)); */
+/*       add_cc_hashtables(&(stack->bot->strand_contin_table), &(old_bottom->strand_prefix_table)); */
 /* #endif */
     }
 
@@ -1376,9 +2221,9 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
 /*     clear_cc_hashtable(old_bottom->lchild_table); */
 /*     clear_cc_hashtable(old_bottom->contin_table); */
 /* #if COMPUTE_STRAND_DATA */
-/*     /\* clear_strand_hashtable(old_bottom->strand_prefix_table); *\/ */
-/*     clear_strand_hashtable(old_bottom->strand_lchild_table); */
-/*     clear_strand_hashtable(old_bottom->strand_contin_table); */
+/*     /\* clear_cc_hashtable(old_bottom->strand_prefix_table); *\/ */
+/*     clear_cc_hashtable(old_bottom->strand_lchild_table); */
+/*     clear_cc_hashtable(old_bottom->strand_contin_table); */
 /* #endif */
   } else {
     // This is the case we are returning to a spawn, since a HELPER 
@@ -1397,26 +2242,52 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
     /* assert(cc_hashtable_is_empty(old_bottom->lchild_table)); */
 #endif
 
+#if BURDENED_SPAN
+    // The spawned child is burdened with the cost of the spawn, and
+    // the continuation with the cost of a steal.
+    uint64_t contin_bspn = c_bottom->running_bspn + stack->bot->contin_bspn;
+    uint64_t child_bspn = old_bottom->prefix_bspn + SPAWN_BURDEN;
+    if (contin_bspn + child_bspn > stack->bot->lchild_bspn) {
+      stack->bot->prefix_bspn += contin_bspn;
+      stack->bot->lchild_bspn = child_bspn;
+      c_bottom->running_bspn = 0;
+      stack->bot->contin_bspn = 0;
+    }
+    stack->bot->contin_bspn += CONTIN_BURDEN;
+#endif
+
     if (c_bottom->running_spn + stack->bot->local_contin + old_bottom->prefix_spn > stack->bot->lchild_spn) {
       // fprintf(stderr, "updating longest child\n");
       stack->bot->prefix_spn += c_bottom->running_spn;
       stack->bot->local_spn += stack->bot->local_contin;
+      WHEN_STRAND_PERF( add_strand_counters(&(stack->bot->prefix_spn_ctr),
+                                            &(c_bottom->running_spn_ctr));
+                        add_strand_counters(&(stack->bot->local_spn_ctr),
+                                            &(stack->bot->local_contin_ctr)); );
       add_cc_hashtables(&(stack->bot->prefix_table), &(stack->bot->contin_table));
 #if COMPUTE_STRAND_DATA
-      add_strand_hashtables(&(stack->bot->strand_prefix_table), &(stack->bot->strand_contin_table));
+      add_cc_hashtables(&(stack->bot->strand_prefix_table), &(stack->bot->strand_contin_table));
 #endif
 
+      // The spawned child becomes the longest child.
+      WHEN_CRITICAL_PATH( stack->bot->prefix_path = path_concat(stack->bot->prefix_path,
+                                                                c_bottom->path);
+                          c_bottom->path = NULL;
+                          path_free(stack->bot->lchild_path);
+                          stack->bot->lchild_path = old_bottom->prefix_path; );
+
       // Save old_bottom tables in new bottom's l_child variable.
       stack->bot->lchild_spn = old_bottom->prefix_spn;
+      WHEN_STRAND_PERF( stack->bot->lchild_spn_ctr = old_bottom->prefix_spn_ctr; );
       clear_cc_hashtable(stack->bot->lchild_table);
       /* free(stack->bot->lchild_table); */
       cc_hashtable_t* tmp_cc = stack->bot->lchild_table;
       stack->bot->lchild_table = old_bottom->prefix_table;
       old_bottom->prefix_table = tmp_cc;
 #if COMPUTE_STRAND_DATA
-      clear_strand_hashtable(stack->bot->strand_lchild_table);
+      clear_cc_hashtable(stack->bot->strand_lchild_table);
       /* free(stack->bot->strand_lchild_table); */
-      strand_hashtable_t* tmp_strand = stack->bot->strand_lchild_table;
+      cc_hashtable_t* tmp_strand = stack->bot->strand_lchild_table;
       stack->bot->strand_lchild_table = old_bottom->strand_prefix_table;
       old_bottom->strand_prefix_table = tmp_strand;
 #endif
@@ -1430,26 +2301,29 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
       /* clear_cc_hashtable(old_bottom->contin_table); */
 #if COMPUTE_STRAND_DATA
       assert(cc_hashtable_is_empty(old_bottom->strand_prefix_table));
-      /* clear_strand_hashtable(old_bottom->strand_lchild_table); */
-      /* clear_strand_hashtable(old_bottom->strand_contin_table); */
+      /* clear_cc_hashtable(old_bottom->strand_lchild_table); */
+      /* clear_cc_hashtable(old_bottom->strand_contin_table); */
 #endif
 
       // Empy new bottom's continuation
       c_bottom->running_spn = 0;
       stack->bot->local_contin = 0;
+      WHEN_STRAND_PERF( clear_strand_counters(&(c_bottom->running_spn_ctr));
+                        clear_strand_counters(&(stack->bot->local_contin_ctr)); );
       clear_cc_hashtable(stack->bot->contin_table);
 #if COMPUTE_STRAND_DATA
-      clear_strand_hashtable(stack->bot->strand_contin_table);
+      clear_cc_hashtable(stack->bot->strand_contin_table);
 #endif
     } else {
+      WHEN_CRITICAL_PATH( path_free(old_bottom->prefix_path); );
       // Discared all tables from old_bottom
       clear_cc_hashtable(old_bottom->prefix_table);
       /* clear_cc_hashtable(old_bottom->lchild_table); */
       /* clear_cc_hashtable(old_bottom->contin_table); */
 #if COMPUTE_STRAND_DATA
-      clear_strand_hashtable(old_bottom->strand_prefix_table);
-      /* clear_strand_hashtable(old_bottom->strand_lchild_table); */
-      /* clear_strand_hashtable(old_bottom->strand_contin_table); */
+      clear_cc_hashtable(old_bottom->strand_prefix_table);
+      /* clear_cc_hashtable(old_bottom->strand_lchild_table); */
+      /* clear_cc_hashtable(old_bottom->strand_contin_table); */
 #endif
     }
   }
@@ -1503,6 +2377,119 @@ void cilk_leave_end(void)
   begin_strand(stack);
 }
 
+/*************************************************************************/
+/**
+ * Profiling regions.
+ *
+ * A region is profiled as if its body were a call to a Cilk function
+ * made at the call to cilkprof_region_begin.  The region therefore
+ * appears as a call site in the overall profile, and its span composes
+ * with the enclosing computation like the span of a Cilk function.  In
+ * particular, cilkprof_region_end implicitly syncs the children spawned
+ * within the region, and a cilk_sync within the region is only charged
+ * for children spawned within the region.  Regions must be properly
+ * nested within the serial execution.
+ */
+
+// Return the profile of the region with the given name, creating it
+// if necessary.
+static cilkprof_region_t* get_region(const char *name) {
+  for (cilkprof_region_t *region = regions; NULL != region; region = region->next) {
+    if (0 == strcmp(region->name, name))
+      return region;
+  }
+  cilkprof_region_t *region = (cilkprof_region_t*)malloc(sizeof(cilkprof_region_t));
+  region->name = strdup(name);
+  region->count = 0;
+  region->wrk = 0;
+  region->spn = 0;
+  region->wrk_table = cc_hashtable_create();
+  region->spn_table = cc_hashtable_create();
+  region->next = NULL;
+  *regions_tail = region;
+  regions_tail = &(region->next);
+  return region;
+}
+
+void cilkprof_region_begin(const char *name)
+{
+  WHEN_TRACE_CALLS( fprintf(stderr, "cilkprof_region_begin(%s) [ret %p]\n", name,
+                            __builtin_extract_return_addr(__builtin_return_address(0))); );
+
+  // Push a frame for the region, identified by this call site
+  cilk_enter_begin(0, NULL, (void*)name, __builtin_return_address(0));
+
+  cilkprof_stack_t *stack = &(GET_STACK(ctx_stack));
+
+  region_frame_t *active = (region_frame_t*)malloc(sizeof(region_frame_t));
+  active->region = get_region(name);
+  active->frame = stack->bot;
+  active->parent = stack->region;
+  stack->region = active;
+
+  // Collect the work and prefix tables of the region separately
+  active->outer_wrk_table = stack->wrk_table;
+  stack->wrk_table = cc_hashtable_create();
+  active->outer_prefix_table = stack->bot->prefix_table;
+  stack->bot->prefix_table = cc_hashtable_create();
+
+  cilk_enter_end(NULL, NULL);
+}
+
+void cilkprof_region_end(void)
+{
+  WHEN_TRACE_CALLS( fprintf(stderr, "cilkprof_region_end() [ret %p]\n",
+                            __builtin_extract_return_addr(__builtin_return_address(0))); );
+
+  cilkprof_stack_t *stack = &(GET_STACK(ctx_stack));
+  region_frame_t *active = stack->region;
+  assert(NULL != active);
+  assert(active->frame == stack->bot);
+
+  // Sync the children spawned within the region, which folds the span
+  // of the region into prefix_spn + local_spn.
+  cilk_sync_begin(NULL);
+  cilk_sync_end(NULL);
+
+  cilkprof_region_t *region = active->region;
+  c_fn_frame_t *c_bottom = &(stack->c_stack[stack->c_tail]);
+  region->wrk += c_bottom->running_wrk + c_bottom->local_wrk;
+  region->spn += stack->bot->prefix_spn + stack->bot->local_spn;
+  ++region->count;
+
+  flush_cc_hashtable(&(stack->wrk_table));
+  accumulate_cc_hashtable(&(region->wrk_table), stack->wrk_table);
+  flush_cc_hashtable(&(stack->bot->prefix_table));
+  accumulate_cc_hashtable(&(region->spn_table), stack->bot->prefix_table);
+
+  // Restore the enclosing tables, with the data of the region added
+  // to them.
+  add_cc_hashtables(&(active->outer_wrk_table), &(stack->wrk_table));
+  free_cc_hashtable(stack->wrk_table);
+  stack->wrk_table = active->outer_wrk_table;
+  add_cc_hashtables(&(active->outer_prefix_table), &(stack->bot->prefix_table));
+  free_cc_hashtable(stack->bot->prefix_table);
+  stack->bot->prefix_table = active->outer_prefix_table;
+
+  // Discard the time of the bookkeeping above, rather than charging
+  // it to the region.
+  measure_strand_length(&(stack->strand_ruler));
+  begin_strand(stack);
+
+  // Pop the frame of the region
+  cilk_leave_begin(NULL);
+  stack->region = active->parent;
+  free(active);
+  cilk_leave_end();
+}
+
 #include "cc_hashtable.c"
 #include "util.c"
 #include "iaddrs.c"
+#include "profile_formats.c"
+#if CRITICAL_PATH
+#include "critical_path.c"
+#endif
+#if COMPUTE_STRAND_DATA
+#include "strand_ids.c"
+#endif
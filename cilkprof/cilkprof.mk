@@ -13,6 +13,30 @@ ifneq ($(BURDENING),)
 CFLAGS += -DBURDENING=$(BURDENING)
 endif
 
+ifeq ($(BURDENED_SPAN),0)
+CFLAGS += -DBURDENED_SPAN=0
+endif
+
+ifeq ($(CALIBRATE_OVERHEAD),0)
+CFLAGS += -DCALIBRATE_OVERHEAD=0
+endif
+
+ifeq ($(STRAND_PERF),1)
+CFLAGS += -DSTRAND_PERF=1
+endif
+
+ifeq ($(SNAPSHOTS),1)
+CFLAGS += -DSNAPSHOTS=1
+endif
+
+ifeq ($(COLLAPSE_SHORT_CALLS),1)
+CFLAGS += -DCOLLAPSE_SHORT_CALLS=1
+endif
+
+ifeq ($(CRITICAL_PATH),1)
+CFLAGS += -DCRITICAL_PATH=1
+endif
+
 ifeq ($(PARALLEL),1)
 CFLAGS += -DSERIAL_TOOL=0 -fcilkplus # -I SFMT-src-1.4.1/
 endif
@@ -21,7 +45,7 @@ ifeq ($(TOOL),cilkprof)
 LDFLAGS += -lrt
 endif
 
-.PHONY : cleancilkprof
+.PHONY : cleancilkprof calibrate-burden
 
 default : $(LIBCILKPROF)
 clean : cleancilkprof
@@ -31,6 +55,20 @@ $(LIBCILKPROF) : $(CILKPROF_OBJ)
 cilkprof.o : # CFLAGS += -flto
 cilkprof.o : # LDFLAGS += -lrt
 
+# Micro-benchmark measuring the burdens of the burdened-span model.
+# Run "make calibrate-burden", then source cilkprof_burden.env before
+# profiling.
+burden_calibrate : burden_calibrate.c
+	$(CC) $(CFLAGS) $(APP_CFLAGS) $(APP_LDFLAGS) $< $(APP_LDLIBS) -o $@
+
+calibrate-burden : burden_calibrate
+	./burden_calibrate > cilkprof_burden.env
+
+# Aggregates the call-site profiles of several runs, e.g.,
+# "cilkprof_stats run*/cilkprof_cs_0.csv > cilkprof_stats.csv".
+cilkprof_stats : cilkprof_stats.c
+	$(CC) $(CFLAGS) $< -lm -o $@
+
 # SFMT-src-1.4.1/SFMT.o: CFLAGS += -DSFMT_MEXP=19937 -DHAVE_SSE2
 
 # SFMT-src-1.4.1/%.o : SFMT-src-1.4.1/%.c
@@ -40,4 +78,4 @@ cilkprof.o : # LDFLAGS += -lrt
 # call_sites.o: CFLAGS += -DSFMT_MEXP=19937 -DHAVE_SSE2
 
 cleancilkprof :
-	rm -f $(LIBCILKPROF) $(CILKPROF_OBJ) $(CILKPROF_OBJ:.o=.d*) *~
+	rm -f $(LIBCILKPROF) $(CILKPROF_OBJ) $(CILKPROF_OBJ:.o=.d*) burden_calibrate cilkprof_stats *~
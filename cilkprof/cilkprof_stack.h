@@ -5,25 +5,59 @@
 #include <time.h>
 #include <limits.h>
 
+#include "strand_counters.h"
+
 #ifndef COMPUTE_STRAND_DATA
 #define COMPUTE_STRAND_DATA 0
 #endif
 
+// Set COLLAPSE_SHORT_CALLS to 1 to stop measuring calls from C call
+// sites that are observed to be short leaf calls many times in a row.
+// Such calls are collapsed into the strand of their caller.
+#ifndef COLLAPSE_SHORT_CALLS
+#define COLLAPSE_SHORT_CALLS 0
+#endif
+
+// Set CRITICAL_PATH to 1 to record the segments of the critical path
+// alongside the span values.
+#ifndef CRITICAL_PATH
+#define CRITICAL_PATH 0
+#endif
+
 // TB: Use this instead of strand_time.h to count strands.  Unlike
 // time, this counts the number of strands encountered, which should
 // be deterministic.
 /* #include "strand_count.h" */
 /* #include "strand_time.h" */
+#if STRAND_PERF
+// Measure strands in cycles together with additional hardware counters
+#include "strand_perf.h"
+#else
 #include "strand_time_rdtsc.h"
+#endif
+#include "overhead.h"
 #include "cc_hashtable.h"
 #if COMPUTE_STRAND_DATA
-#include "strand_hashtable.h"
+#include "strand_ids.h"
+#endif
+#if CRITICAL_PATH
+#include "critical_path.h"
+#endif
+
+#if COMPUTE_STRAND_DATA
+// Create a table of strand data, indexed by strand index
+static inline cc_hashtable_t* strand_table_create(void) {
+  return cc_hashtable_create_bounded(&MIN_STRAND_CAPACITY);
+}
 #endif
 
 // Used to size call site and function status vectors
 const int START_STATUS_VECTOR_SIZE = 4;
 
 const int START_C_STACK_SIZE = 8;
+
+// Stack frames are carved from slabs of this many frames.
+const int FRAME_SLAB_SIZE = 64;
 /* const int TOP_INDEX_FLAG = INT_MIN; */
 
 typedef struct c_fn_frame_t {
@@ -36,6 +70,11 @@ typedef struct c_fn_frame_t {
   int32_t cs_index;
   /* int fn_index; */
 
+#if COLLAPSE_SHORT_CALLS
+  // Number of collapsed calls executing directly in this function
+  uint32_t collapsed_calls;
+#endif
+
 #ifndef NDEBUG
   // Return address of this function
   uintptr_t rip;
@@ -49,9 +88,29 @@ typedef struct c_fn_frame_t {
   uint64_t running_wrk;
   uint64_t running_spn;
 
+#if BURDENED_SPAN
+  // Burdened analogue of running_spn
+  uint64_t running_bspn;
+#endif
+
+#if STRAND_PERF
+  // Hardware-counter analogues of the work and span values above
+  strand_counters_t local_wrk_ctr;
+  strand_counters_t running_wrk_ctr;
+  strand_counters_t running_spn_ctr;
+#endif
+
+#if CRITICAL_PATH
+  // Longest path through this function since its call, or through
+  // the continuation of a Cilk function, in the order executed.  Its
+  // length is running_spn + local_wrk, or running_spn + local_contin of
+  // the Cilk function.
+  path_node_t *path;
+#endif
+
   /* // Parent of this C function on the same stack */
   /* struct c_fn_frame_t *parent; */
-} c_fn_frame_t __attribute__((aligned(16)));
+} __attribute__((aligned(16))) c_fn_frame_t;
 
 // Type for cilkprof stack frame
 typedef struct cilkprof_stack_frame_t {
@@ -101,25 +160,53 @@ typedef struct cilkprof_stack_frame_t {
   // The span of the continuation is stored in the running_spn + local_contin
   // in the topmost c_fn_frame
 
+#if BURDENED_SPAN
+  // Burdened span of the prefix of this function, including its own
+  // strands
+  uint64_t prefix_bspn;
+  // Burdened span of the longest spawned child, by burdened span,
+  // since the last sync
+  uint64_t lchild_bspn;
+  // Burdened span of the strands of the continuation, including the
+  // burdens of continuations of spawns.  The burdened span of the
+  // continuation is contin_bspn + running_bspn in the topmost
+  // c_fn_frame.
+  uint64_t contin_bspn;
+#endif
+
+#if CRITICAL_PATH
+  // Paths of length prefix_spn + local_spn and lchild_spn
+  path_node_t *prefix_path;
+  path_node_t *lchild_path;
+#endif
+
+#if STRAND_PERF
+  // Hardware-counter analogues of the span values above
+  strand_counters_t local_contin_ctr;
+  strand_counters_t local_spn_ctr;
+  strand_counters_t prefix_spn_ctr;
+  strand_counters_t lchild_spn_ctr;
+#endif
+
   // Data associated with the function's prefix
   cc_hashtable_t* prefix_table;
 #if COMPUTE_STRAND_DATA
   // Strand data associated with prefix
-  strand_hashtable_t* strand_prefix_table;
+  cc_hashtable_t* strand_prefix_table;
 #endif
 
   // Data associated with the function's longest child
   cc_hashtable_t* lchild_table;
 #if COMPUTE_STRAND_DATA
   // Strand data associated with longest child
-  strand_hashtable_t* strand_lchild_table;
+  cc_hashtable_t* strand_lchild_table;
 #endif
 
   // Data associated with the function's continuation
   cc_hashtable_t* contin_table;
 #if COMPUTE_STRAND_DATA
   // Strand data associated with continuation
-  strand_hashtable_t* strand_contin_table;
+  cc_hashtable_t* strand_contin_table;
 #endif
 
   // Pointer to the frame's parent
@@ -127,6 +214,37 @@ typedef struct cilkprof_stack_frame_t {
 } cilkprof_stack_frame_t;
 
 
+// Profile of a named region, aggregated over all of its executions
+typedef struct cilkprof_region_t {
+  // Name passed to cilkprof_region_begin
+  char *name;
+  // Number of completed executions of the region
+  uint32_t count;
+  // Work and span of the region
+  uint64_t wrk;
+  uint64_t spn;
+  // Call-site data associated with the work and span of the region
+  cc_hashtable_t *wrk_table;
+  cc_hashtable_t *spn_table;
+  // Next region in order of first execution
+  struct cilkprof_region_t *next;
+} cilkprof_region_t;
+
+// Execution of a region that is currently active on a stack
+typedef struct region_frame_t {
+  // Profile of the region
+  cilkprof_region_t *region;
+  // Stack frame that accumulates the work and span of the region
+  cilkprof_stack_frame_t *frame;
+  // Work table of the enclosing computation and prefix table that
+  // frame shares with its parent, which are restored when the region
+  // ends
+  cc_hashtable_t *outer_wrk_table;
+  cc_hashtable_t *outer_prefix_table;
+  // Enclosing active region
+  struct region_frame_t *parent;
+} region_frame_t;
+
 // Metadata for a call site
 typedef struct {
   /* uint32_t count_on_stack; */
@@ -134,15 +252,31 @@ typedef struct {
   int32_t c_tail;
   int32_t fn_index;
   uint32_t flags;
+#if COLLAPSE_SHORT_CALLS
+  // Number of consecutive short leaf calls from this call site
+  uint32_t short_calls;
+#endif
 } cs_status_t;
 
 // Metadata for a function
 typedef int32_t fn_status_t;
 
 const uint32_t RECURSIVE = 1;
+// Calls from this call site are collapsed into their caller
+const uint32_t COLLAPSED = 2;
 const int32_t OFF_STACK = INT32_MIN;
 const int32_t UNINITIALIZED = INT32_MIN;
 
+#if COLLAPSE_SHORT_CALLS
+// Number of entries in the cache of collapsed call sites
+#define COLLAPSED_CS_CACHE_SIZE 256
+
+// Slot of the cache of collapsed call sites for return address cs
+static inline size_t collapsed_cs_slot(uintptr_t cs) {
+  return (cs >> 2) & (COLLAPSED_CS_CACHE_SIZE - 1);
+}
+#endif
+
 // Type for a cilkprof stack
 typedef struct {
   // Flag to indicate whether user code is being executed.  This flag
@@ -164,6 +298,11 @@ typedef struct {
   // Tool for measuring the length of a strand
   strand_ruler_t strand_ruler;
 
+#if CALIBRATE_OVERHEAD
+  // Number of strands measured, each corrected for the overhead
+  uint64_t num_strands;
+#endif
+
   // Stack of C function frames
   c_fn_frame_t *c_stack;
 
@@ -177,13 +316,22 @@ typedef struct {
 
   // Call-site data associated with the running work
   cc_hashtable_t* wrk_table;
+
+  // Innermost active profiling region, or NULL
+  region_frame_t *region;
+
+#if COLLAPSE_SHORT_CALLS
+  // Direct-mapped cache of the return addresses of collapsed call
+  // sites, checked before a call is measured
+  uintptr_t *collapsed_cs;
+#endif
 #if COMPUTE_STRAND_DATA
   // Endpoints of currently executing strand
   uintptr_t strand_start;
   uintptr_t strand_end;
 
   // Strand data associated with running work
-  strand_hashtable_t* strand_wrk_table;
+  cc_hashtable_t* strand_wrk_table;
 #endif
 
   /* // Free list of C function frames */
@@ -195,6 +343,12 @@ typedef struct {
   // Free list of cilkprof stack frames for spawners
   cilkprof_stack_frame_t *spawner_sf_free_list;
 
+  // Slabs from which new stack frames are carved.  The first frame of
+  // each slab links the slabs together through its parent.
+  cilkprof_stack_frame_t *frame_slabs;
+  // Number of frames carved from the newest slab
+  int frame_slab_used;
+
 } cilkprof_stack_t;
 
 
@@ -223,6 +377,9 @@ void cilkprof_c_fn_frame_init(c_fn_frame_t *c_fn_frame) {
 
   c_fn_frame->cs_index = 0;
   /* c_fn_frame->fn_index = 0; */
+#if COLLAPSE_SHORT_CALLS
+  c_fn_frame->collapsed_calls = 0;
+#endif
 
 #ifndef NDEBUG
   c_fn_frame->rip = (uintptr_t)NULL;
@@ -233,6 +390,17 @@ void cilkprof_c_fn_frame_init(c_fn_frame_t *c_fn_frame) {
   /* c_fn_frame->local_contin = 0; */
   c_fn_frame->running_wrk = 0;
   c_fn_frame->running_spn = 0;
+#if BURDENED_SPAN
+  c_fn_frame->running_bspn = 0;
+#endif
+#if CRITICAL_PATH
+  c_fn_frame->path = NULL;
+#endif
+#if STRAND_PERF
+  clear_strand_counters(&(c_fn_frame->local_wrk_ctr));
+  clear_strand_counters(&(c_fn_frame->running_wrk_ctr));
+  clear_strand_counters(&(c_fn_frame->running_spn_ctr));
+#endif
 
   /* c_fn_frame->parent = NULL; */
 }
@@ -265,32 +433,47 @@ void cilkprof_stack_frame_init(cilkprof_stack_frame_t *frame,
   frame->prefix_spn = 0; 
   frame->lchild_spn = 0;
   /* frame->contin_spn = 0; */
+#if BURDENED_SPAN
+  frame->prefix_bspn = 0;
+  frame->lchild_bspn = 0;
+  frame->contin_bspn = 0;
+#endif
+#if CRITICAL_PATH
+  frame->prefix_path = NULL;
+  frame->lchild_path = NULL;
+#endif
+#if STRAND_PERF
+  clear_strand_counters(&(frame->local_contin_ctr));
+  clear_strand_counters(&(frame->local_spn_ctr));
+  clear_strand_counters(&(frame->prefix_spn_ctr));
+  clear_strand_counters(&(frame->lchild_spn_ctr));
+#endif
 
   if (HELPER == func_type) {
     assert(cc_hashtable_is_empty(frame->prefix_table));
     /* clear_cc_hashtable(frame->prefix_table); */
     /* frame->prefix_table = cc_hashtable_create(); */
 #if COMPUTE_STRAND_DATA
-    assert(strand_hashtable_is_empty(frame->strand_prefix_table));
-    /* clear_strand_hashtable(frame->strand_prefix_table); */
-    /* frame->strand_prefix_table = strand_hashtable_create(); */
+    assert(cc_hashtable_is_empty(frame->strand_prefix_table));
+    /* clear_cc_hashtable(frame->strand_prefix_table); */
+    /* frame->strand_prefix_table = strand_table_create(); */
 #endif
   } else {
     assert(cc_hashtable_is_empty(frame->lchild_table));
     /* clear_cc_hashtable(frame->lchild_table); */
     /* frame->lchild_table = cc_hashtable_create(); */
 #if COMPUTE_STRAND_DATA
-    assert(strand_hashtable_is_empty(frame->strand_lchild_table));
-    /* clear_strand_hashtable(frame->strand_lchild_table); */
-    /* frame->strand_lchild_table = strand_hashtable_create(); */
+    assert(cc_hashtable_is_empty(frame->strand_lchild_table));
+    /* clear_cc_hashtable(frame->strand_lchild_table); */
+    /* frame->strand_lchild_table = strand_table_create(); */
 #endif
     assert(cc_hashtable_is_empty(frame->contin_table));
     /* clear_cc_hashtable(frame->contin_table); */
     /* frame->contin_table = cc_hashtable_create(); */
 #if COMPUTE_STRAND_DATA
-    assert(strand_hashtable_is_empty(frame->strand_contin_table));
-    /* clear_strand_hashtable(frame->strand_contin_table); */
-    /* frame->strand_contin_table = strand_hashtable_create(); */
+    assert(cc_hashtable_is_empty(frame->strand_contin_table));
+    /* clear_cc_hashtable(frame->strand_contin_table); */
+    /* frame->strand_contin_table = strand_table_create(); */
 #endif
   }
 }
@@ -329,6 +512,35 @@ c_fn_frame_t* cilkprof_c_fn_push(cilkprof_stack_t *stack)
 }
 
 
+// Carve a new frame from the newest slab of stack, allocating a slab
+// if it is used up.  Frames are never returned to the slabs, but are
+// recycled through the free lists of stack.
+static cilkprof_stack_frame_t*
+cilkprof_stack_frame_alloc(cilkprof_stack_t *stack)
+{
+  if (NULL == stack->frame_slabs || FRAME_SLAB_SIZE == stack->frame_slab_used) {
+    cilkprof_stack_frame_t *slab =
+      (cilkprof_stack_frame_t *)malloc(sizeof(cilkprof_stack_frame_t)
+                                       * FRAME_SLAB_SIZE);
+    slab[0].parent = stack->frame_slabs;
+    stack->frame_slabs = slab;
+    stack->frame_slab_used = 1;
+  }
+  return &(stack->frame_slabs[stack->frame_slab_used++]);
+}
+
+// Free the slabs of stack frames of stack.
+void cilkprof_stack_free_slabs(cilkprof_stack_t *stack)
+{
+  while (NULL != stack->frame_slabs) {
+    cilkprof_stack_frame_t *next = stack->frame_slabs[0].parent;
+    free(stack->frame_slabs);
+    stack->frame_slabs = next;
+  }
+  stack->frame_slab_used = 0;
+}
+
+
 // Push new frame of function type func_type onto the stack *stack
 __attribute__((always_inline))
 cilkprof_stack_frame_t*
@@ -340,7 +552,7 @@ cilkprof_stack_push(cilkprof_stack_t *stack, FunctionType_t func_type)
       new_frame = stack->helper_sf_free_list;
       stack->helper_sf_free_list = stack->helper_sf_free_list->parent;
     } else {
-      new_frame = (cilkprof_stack_frame_t *)malloc(sizeof(cilkprof_stack_frame_t));
+      new_frame = cilkprof_stack_frame_alloc(stack);
 
       /* c_fn_frame_t *new_c_frame; */
       /* if (NULL != stack->c_fn_free_list) { */
@@ -353,19 +565,19 @@ cilkprof_stack_push(cilkprof_stack_t *stack, FunctionType_t func_type)
 
       new_frame->prefix_table = cc_hashtable_create();
 #if COMPUTE_STRAND_DATA
-      new_frame->strand_prefix_table = strand_hashtable_create();
+      new_frame->strand_prefix_table = strand_table_create();
 #endif
       new_frame->lchild_table = NULL;
       /* new_frame->lchild_table = cc_hashtable_create(); */
 #if COMPUTE_STRAND_DATA
       new_frame->strand_lchild_table = NULL;
-      /* new_frame->strand_lchild_table = strand_hashtable_create(); */
+      /* new_frame->strand_lchild_table = strand_table_create(); */
 #endif
       new_frame->contin_table = NULL;
       /* new_frame->contin_table = cc_hashtable_create(); */
 #if COMPUTE_STRAND_DATA
       new_frame->strand_contin_table = NULL;
-      /* new_frame->strand_contin_table = strand_hashtable_create(); */
+      /* new_frame->strand_contin_table = strand_table_create(); */
 #endif
     }
   } else {
@@ -373,7 +585,7 @@ cilkprof_stack_push(cilkprof_stack_t *stack, FunctionType_t func_type)
       new_frame = stack->spawner_sf_free_list;
       stack->spawner_sf_free_list = stack->spawner_sf_free_list->parent;
     } else {
-      new_frame = (cilkprof_stack_frame_t *)malloc(sizeof(cilkprof_stack_frame_t));
+      new_frame = cilkprof_stack_frame_alloc(stack);
 
       /* c_fn_frame_t *new_c_frame; */
       /* if (NULL != stack->c_fn_free_list) { */
@@ -386,11 +598,11 @@ cilkprof_stack_push(cilkprof_stack_t *stack, FunctionType_t func_type)
 
       new_frame->lchild_table = cc_hashtable_create();
 #if COMPUTE_STRAND_DATA
-      new_frame->strand_lchild_table = strand_hashtable_create();
+      new_frame->strand_lchild_table = strand_table_create();
 #endif
       new_frame->contin_table = cc_hashtable_create();
 #if COMPUTE_STRAND_DATA
-      new_frame->strand_contin_table = strand_hashtable_create();
+      new_frame->strand_contin_table = strand_table_create();
 #endif
     }
     if (0 == stack->bot->lchild_spn) {
@@ -425,6 +637,9 @@ void cilkprof_stack_init(cilkprof_stack_t *stack, FunctionType_t func_type)
   stack->bot = NULL;
   stack->helper_sf_free_list = NULL;
   stack->spawner_sf_free_list = NULL;
+  stack->frame_slabs = NULL;
+  stack->frame_slab_used = 0;
+  stack->region = NULL;
   /* stack->c_fn_free_list = NULL; */
 
   stack->c_stack = (c_fn_frame_t*)malloc(sizeof(c_fn_frame_t) * START_C_STACK_SIZE);
@@ -435,15 +650,15 @@ void cilkprof_stack_init(cilkprof_stack_t *stack, FunctionType_t func_type)
 
   new_frame->prefix_table = cc_hashtable_create();
 #if COMPUTE_STRAND_DATA
-  new_frame->strand_prefix_table = strand_hashtable_create();
+  new_frame->strand_prefix_table = strand_table_create();
 #endif
   new_frame->lchild_table = cc_hashtable_create();
 #if COMPUTE_STRAND_DATA
-  new_frame->strand_lchild_table = strand_hashtable_create();
+  new_frame->strand_lchild_table = strand_table_create();
 #endif
   new_frame->contin_table = cc_hashtable_create();
 #if COMPUTE_STRAND_DATA
-  new_frame->strand_contin_table = strand_hashtable_create();
+  new_frame->strand_contin_table = strand_table_create();
 #endif
 
   cilkprof_stack_frame_init(new_frame, func_type, 0);
@@ -453,7 +668,7 @@ void cilkprof_stack_init(cilkprof_stack_t *stack, FunctionType_t func_type)
 
   stack->wrk_table = cc_hashtable_create();
 #if COMPUTE_STRAND_DATA
-  stack->strand_wrk_table = strand_hashtable_create();
+  stack->strand_wrk_table = strand_table_create();
 #endif
 
   stack->cs_status_capacity = START_STATUS_VECTOR_SIZE;
@@ -471,10 +686,21 @@ void cilkprof_stack_init(cilkprof_stack_t *stack, FunctionType_t func_type)
     stack->cs_status[i].c_tail = OFF_STACK;
     stack->cs_status[i].fn_index = UNINITIALIZED;
     stack->cs_status[i].flags = 0;
+#if COLLAPSE_SHORT_CALLS
+    stack->cs_status[i].short_calls = 0;
+#endif
     stack->fn_status[i] = OFF_STACK;
   }
 
+#if COLLAPSE_SHORT_CALLS
+  stack->collapsed_cs = (uintptr_t*)calloc(COLLAPSED_CS_CACHE_SIZE,
+                                           sizeof(uintptr_t));
+#endif
+
   init_strand_ruler(&(stack->strand_ruler));
+#if CALIBRATE_OVERHEAD
+  stack->num_strands = 0;
+#endif
 }
 
 // Doubles the capacity of a cs status vector
@@ -492,6 +718,9 @@ void resize_cs_status_vector(cs_status_t **old_status_vec,
     new_status_vec[i].c_tail = OFF_STACK;
     new_status_vec[i].fn_index = UNINITIALIZED;
     new_status_vec[i].flags = 0;
+#if COLLAPSE_SHORT_CALLS
+    new_status_vec[i].short_calls = 0;
+#endif
   }
 
   free(*old_status_vec);
@@ -80,6 +80,9 @@ void reduce_cilkprof_stack(void *reducer, void *l, void *r)
   }
   /* running_wrk is maintained as a sum reducer */
   left->bot->running_wrk += right->bot->running_wrk;
+#if CALIBRATE_OVERHEAD
+  left->num_strands += right->num_strands;
+#endif
 
   /* fprintf(stderr, "\tleft work (%p) += right work (%p)\n", */
   /* 	  &(left->wrk_table), &(right->wrk_table)); */
@@ -142,16 +145,16 @@ void destroy_cilkprof_stack(void *reducer, void *view)
 {
   // Free component tables
   if (NULL != ((cilkprof_stack_t*)view)->wrk_table) {
-    free(((cilkprof_stack_t*)view)->wrk_table);
+    free_cc_hashtable(((cilkprof_stack_t*)view)->wrk_table);
   }
   if (NULL != ((cilkprof_stack_t*)view)->bot->prefix_table) {
-    free(((cilkprof_stack_t*)view)->bot->prefix_table);
+    free_cc_hashtable(((cilkprof_stack_t*)view)->bot->prefix_table);
   }
   if (NULL != ((cilkprof_stack_t*)view)->bot->lchild_table) {
-    free(((cilkprof_stack_t*)view)->bot->lchild_table);
+    free_cc_hashtable(((cilkprof_stack_t*)view)->bot->lchild_table);
   }
   if (NULL != ((cilkprof_stack_t*)view)->bot->contin_table) {
-    free(((cilkprof_stack_t*)view)->bot->contin_table);
+    free_cc_hashtable(((cilkprof_stack_t*)view)->bot->contin_table);
   }
 
   // Free the view
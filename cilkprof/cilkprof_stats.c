@@ -0,0 +1,352 @@
+// Aggregates the call-site profiles of several runs of a program into
+// one profile that reports, for every call site and every column of the
+// profiles, the mean, the median and the half-width of the 95%
+// confidence interval of the mean over the runs:
+//
+//   cilkprof_stats [-k KEYS] run1/cilkprof_cs_0.csv run2/cilkprof_cs_0.csv ...
+//
+// The first KEYS columns of a row, 4 by default, identify its call
+// site.  The remaining columns are numbers.  The profiles are read one
+// at a time, and every statistic is computed online -- the mean and
+// variance by Welford's method, and the median by the P-square
+// algorithm of Jain and Chlamtac -- so the memory used does not grow
+// with the number of runs.  Values that are not finite are ignored, as
+// are the values that cilkprof prints when it has no data, such as the
+// parallelism of a call site with no entry in the span table.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+static const int DEFAULT_KEY_COLUMNS = 4;
+static const char *SEPARATOR = ", ";
+
+// cilkprof prints DBL_MAX with %g for a value it has no data for, and
+// that reads back as this value, which is just below DBL_MAX.
+static const double NO_DATA = 1.79769e+308;
+
+// Online estimate of the median, following the P-square algorithm with
+// p = 1/2.  The first 5 observations are kept in height.
+typedef struct {
+  // Heights of the markers
+  double height[5];
+  // Positions of the markers, counting from 1
+  double pos[5];
+  // Desired positions of the markers
+  double desired[5];
+} median_t;
+
+// Online mean and variance, following Welford
+typedef struct {
+  uint64_t n;
+  double mean;
+  // Sum of squared differences from the mean
+  double m2;
+  median_t median;
+} stat_t;
+
+// Statistics of one call site
+typedef struct site_t {
+  // Key columns of the call site, joined by SEPARATOR
+  char *key;
+  // Number of runs in which the call site appears
+  uint64_t runs;
+  // Statistics of each value column
+  stat_t *stats;
+  // Next call site in the same bucket of the table
+  struct site_t *next;
+  // Next call site in order of first appearance
+  struct site_t *next_in_order;
+} site_t;
+
+// Table of call sites, chained by hash of the key
+typedef struct {
+  int lg_capacity;
+  int num_sites;
+  site_t **buckets;
+  site_t *first;
+  site_t **last;
+} site_table_t;
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+// Parabolic prediction of the height of marker i moved by d
+static double median_parabolic(const median_t *m, int i, double d) {
+  const double *q = m->height, *n = m->pos;
+  return q[i] + d / (n[i+1] - n[i-1])
+    * ((n[i] - n[i-1] + d) * (q[i+1] - q[i]) / (n[i+1] - n[i])
+       + (n[i+1] - n[i] - d) * (q[i] - q[i-1]) / (n[i] - n[i-1]));
+}
+
+// Add x, the count-th observation, to the median estimate m.
+static void median_add(median_t *m, uint64_t count, double x) {
+  if (count <= 5) {
+    m->height[count - 1] = x;
+    if (5 == count) {
+      qsort(m->height, 5, sizeof(double), compare_doubles);
+      for (int i = 0; i < 5; ++i)
+        m->pos[i] = i + 1;
+      m->desired[0] = 1;
+      m->desired[1] = 2;
+      m->desired[2] = 3;
+      m->desired[3] = 4;
+      m->desired[4] = 5;
+    }
+    return;
+  }
+
+  // Find the cell of x, extending the extreme markers if necessary.
+  int k;
+  if (x < m->height[0]) {
+    m->height[0] = x;
+    k = 0;
+  } else if (x >= m->height[4]) {
+    m->height[4] = x;
+    k = 3;
+  } else {
+    for (k = 0; x >= m->height[k + 1]; ++k)
+      ;
+  }
+  for (int i = k + 1; i < 5; ++i)
+    m->pos[i] += 1;
+  static const double increment[5] = { 0, 0.25, 0.5, 0.75, 1 };
+  for (int i = 0; i < 5; ++i)
+    m->desired[i] += increment[i];
+
+  // Adjust the middle markers toward their desired positions.
+  for (int i = 1; i < 4; ++i) {
+    double d = m->desired[i] - m->pos[i];
+    if ((d >= 1 && m->pos[i+1] - m->pos[i] > 1) ||
+        (d <= -1 && m->pos[i-1] - m->pos[i] < -1)) {
+      d = (d > 0) ? 1 : -1;
+      double q = median_parabolic(m, i, d);
+      if (!(m->height[i-1] < q && q < m->height[i+1])) {
+        // Linear prediction
+        int j = i + (int)d;
+        q = m->height[i] + d * (m->height[j] - m->height[i]) / (m->pos[j] - m->pos[i]);
+      }
+      m->height[i] = q;
+      m->pos[i] += d;
+    }
+  }
+}
+
+// Return the estimate of the median of the count observations in m.
+static double median_get(const median_t *m, uint64_t count) {
+  if (count > 5)
+    return m->height[2];
+  double sorted[5];
+  memcpy(sorted, m->height, sizeof(double) * count);
+  qsort(sorted, count, sizeof(double), compare_doubles);
+  return (count % 2) ? sorted[count / 2]
+    : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+}
+
+static void stat_add(stat_t *s, double x) {
+  ++s->n;
+  double delta = x - s->mean;
+  s->mean += delta / s->n;
+  s->m2 += delta * (x - s->mean);
+  median_add(&(s->median), s->n, x);
+}
+
+// Two-sided 97.5th percentiles of Student's t distribution with 1 to 30
+// degrees of freedom
+static const double T_975[30] = {
+  12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+  2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+  2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+// Return the half-width of the 95% confidence interval of the mean of
+// s, or 0 if it has fewer than 2 observations.
+static double stat_ci95(const stat_t *s) {
+  if (s->n < 2)
+    return 0;
+  uint64_t df = s->n - 1;
+  double t = (df <= 30) ? T_975[df - 1] : 1.960;
+  return t * sqrt(s->m2 / df / s->n);
+}
+
+static uint64_t hash_key(const char *key) {
+  // FNV-1a
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (; '\0' != *key; ++key) {
+    h ^= (unsigned char)*key;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static void site_table_init(site_table_t *tab) {
+  tab->lg_capacity = 8;
+  tab->num_sites = 0;
+  tab->buckets = (site_t**)calloc(1 << tab->lg_capacity, sizeof(site_t*));
+  tab->first = NULL;
+  tab->last = &(tab->first);
+}
+
+static void site_table_grow(site_table_t *tab) {
+  int new_lg_capacity = tab->lg_capacity + 1;
+  site_t **buckets = (site_t**)calloc(1 << new_lg_capacity, sizeof(site_t*));
+  for (site_t *site = tab->first; NULL != site; site = site->next_in_order) {
+    uint64_t b = hash_key(site->key) & ((1 << new_lg_capacity) - 1);
+    site->next = buckets[b];
+    buckets[b] = site;
+  }
+  free(tab->buckets);
+  tab->buckets = buckets;
+  tab->lg_capacity = new_lg_capacity;
+}
+
+// Return the call site with the given key, adding it if necessary.
+static site_t* site_table_get(site_table_t *tab, const char *key,
+                              int num_values) {
+  uint64_t b = hash_key(key) & ((1 << tab->lg_capacity) - 1);
+  for (site_t *site = tab->buckets[b]; NULL != site; site = site->next) {
+    if (0 == strcmp(site->key, key))
+      return site;
+  }
+
+  site_t *site = (site_t*)malloc(sizeof(site_t));
+  site->key = strdup(key);
+  site->runs = 0;
+  site->stats = (stat_t*)calloc(num_values, sizeof(stat_t));
+  site->next = tab->buckets[b];
+  tab->buckets[b] = site;
+  site->next_in_order = NULL;
+  *(tab->last) = site;
+  tab->last = &(site->next_in_order);
+  if (++tab->num_sites > (1 << tab->lg_capacity))
+    site_table_grow(tab);
+  return site;
+}
+
+// Split line at each SEPARATOR, in place, storing at most max_fields
+// fields in fields.  Returns the number of fields.
+static int split_fields(char *line, char **fields, int max_fields) {
+  line[strcspn(line, "\r\n")] = '\0';
+  int n = 0;
+  char *field = line;
+  while (n < max_fields) {
+    fields[n++] = field;
+    char *sep = strstr(field, SEPARATOR);
+    if (NULL == sep)
+      break;
+    *sep = '\0';
+    field = sep + strlen(SEPARATOR);
+  }
+  // Drop trailing blanks of the last field.
+  char *end = fields[n - 1] + strlen(fields[n - 1]);
+  while (end > fields[n - 1] && ' ' == end[-1])
+    *--end = '\0';
+  return n;
+}
+
+int main(int argc, char *argv[]) {
+  int key_columns = DEFAULT_KEY_COLUMNS;
+  int first_file = 1;
+  if (argc > 2 && 0 == strcmp(argv[1], "-k")) {
+    key_columns = atoi(argv[2]);
+    first_file = 3;
+  }
+  if (first_file >= argc || key_columns < 1) {
+    fprintf(stderr, "usage: %s [-k KEYS] PROFILE.csv...\n", argv[0]);
+    return 1;
+  }
+
+  site_table_t sites;
+  site_table_init(&sites);
+  char *header = NULL;
+  int num_columns = 0;
+  char **fields = NULL;
+  char *line = NULL;
+  size_t line_capacity = 0;
+  size_t key_capacity = 0;
+  char *key = NULL;
+
+  for (int f = first_file; f < argc; ++f) {
+    FILE *fin = fopen(argv[f], "r");
+    if (NULL == fin) {
+      perror(argv[f]);
+      return 1;
+    }
+
+    // Every profile must have the same columns.
+    if (getline(&line, &line_capacity, fin) < 0) {
+      fprintf(stderr, "%s: empty profile\n", argv[f]);
+      return 1;
+    }
+    if (NULL == header) {
+      header = strdup(line);
+      num_columns = 1;
+      for (const char *s = line; NULL != (s = strstr(s, SEPARATOR)); s += strlen(SEPARATOR))
+        ++num_columns;
+      if (num_columns <= key_columns) {
+        fprintf(stderr, "%s: no value columns\n", argv[f]);
+        return 1;
+      }
+      fields = (char**)malloc(sizeof(char*) * num_columns);
+    } else if (0 != strcmp(header, line)) {
+      fprintf(stderr, "%s: columns differ from those of %s\n", argv[f], argv[first_file]);
+      return 1;
+    }
+
+    while (getline(&line, &line_capacity, fin) >= 0) {
+      if (split_fields(line, fields, num_columns) != num_columns)
+        continue;
+
+      // Join the key columns.
+      size_t key_len = 0;
+      for (int i = 0; i < key_columns; ++i)
+        key_len += strlen(fields[i]) + strlen(SEPARATOR);
+      if (key_len + 1 > key_capacity) {
+        key_capacity = 2 * (key_len + 1);
+        key = (char*)realloc(key, key_capacity);
+      }
+      key[0] = '\0';
+      for (int i = 0; i < key_columns; ++i) {
+        if (i > 0)
+          strcat(key, SEPARATOR);
+        strcat(key, fields[i]);
+      }
+
+      site_t *site = site_table_get(&sites, key, num_columns - key_columns);
+      ++site->runs;
+      for (int i = key_columns; i < num_columns; ++i) {
+        double x = strtod(fields[i], NULL);
+        if (isfinite(x) && fabs(x) < NO_DATA)
+          stat_add(&(site->stats[i - key_columns]), x);
+      }
+    }
+    fclose(fin);
+  }
+
+  // Print the header, with three columns for every value column.
+  split_fields(header, fields, num_columns);
+  for (int i = 0; i < key_columns; ++i)
+    printf("%s, ", fields[i]);
+  printf("runs");
+  for (int i = key_columns; i < num_columns; ++i)
+    printf(", %s mean, %s median, %s ci95", fields[i], fields[i], fields[i]);
+  printf("\n");
+
+  for (site_t *site = sites.first; NULL != site; site = site->next_in_order) {
+    printf("%s, %lu", site->key, site->runs);
+    for (int i = 0; i < num_columns - key_columns; ++i) {
+      const stat_t *s = &(site->stats[i]);
+      if (0 == s->n)
+        printf(", nan, nan, nan");
+      else
+        printf(", %g, %g, %g", s->mean, median_get(&(s->median), s->n), stat_ci95(s));
+    }
+    printf("\n");
+  }
+
+  return 0;
+}
@@ -0,0 +1,152 @@
+#include "critical_path.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/**
+ * Method implementations
+ */
+// Nodes are allocated from slabs of this many nodes.  The first node
+// of each slab links the slabs together.
+static const int PATH_SLAB_SIZE = 1024;
+
+static path_node_t *path_free_list = NULL;
+static path_node_t *path_slabs = NULL;
+
+static path_node_t* path_node_alloc(void) {
+  if (NULL == path_free_list) {
+    path_node_t *slab = (path_node_t*)malloc(sizeof(path_node_t) * PATH_SLAB_SIZE);
+    slab[0].left = path_slabs;
+    path_slabs = slab;
+    for (int i = 1; i < PATH_SLAB_SIZE; ++i) {
+      slab[i].left = path_free_list;
+      path_free_list = &slab[i];
+    }
+  }
+  path_node_t *node = path_free_list;
+  path_free_list = node->left;
+  return node;
+}
+
+static inline void path_node_release(path_node_t *node) {
+  node->left = path_free_list;
+  path_free_list = node;
+}
+
+static inline bool path_segment_p(const path_node_t *node) {
+  return node->cs_index >= 0;
+}
+
+// Append a segment of the given length in call site cs_index to path.
+// The segment is merged into the last segment of path if they are in
+// the same call site.  Returns the resulting path.
+path_node_t* path_append_segment(path_node_t *path, int32_t cs_index,
+                                 uint64_t length) {
+  assert(cs_index >= 0);
+  if (0 == length)
+    return path;
+
+  if (NULL != path) {
+    if (path_segment_p(path)) {
+      if (cs_index == path->cs_index) {
+        path->length += length;
+        return path;
+      }
+    } else if (path_segment_p(path->right) && cs_index == path->right->cs_index) {
+      path->right->length += length;
+      path->length += length;
+      return path;
+    }
+  }
+
+  path_node_t *segment = path_node_alloc();
+  segment->cs_index = cs_index;
+  segment->length = length;
+  segment->left = NULL;
+  segment->right = NULL;
+  return path_concat(path, segment);
+}
+
+// Return the path of first followed by second, which consumes both.
+path_node_t* path_concat(path_node_t *first, path_node_t *second) {
+  if (NULL == first)
+    return second;
+  if (NULL == second)
+    return first;
+
+  path_node_t *node = path_node_alloc();
+  node->cs_index = -1;
+  node->length = first->length + second->length;
+  node->left = first;
+  node->right = second;
+  return node;
+}
+
+// Release the nodes of path.  Paths can be deep, so the rope is
+// flattened by rotations instead of recursion.
+void path_free(path_node_t *path) {
+  while (NULL != path) {
+    if (NULL == path->left) {
+      path_node_t *next = path->right;
+      path_node_release(path);
+      path = next;
+    } else {
+      path_node_t *left = path->left;
+      path->left = left->right;
+      left->right = path;
+      path = left;
+    }
+  }
+}
+
+// Free all nodes, including those still in paths.
+void path_pool_free(void) {
+  while (NULL != path_slabs) {
+    path_node_t *next = path_slabs[0].left;
+    free(path_slabs);
+    path_slabs = next;
+  }
+  path_free_list = NULL;
+}
+
+
+static void path_iter_push(path_iter_t *iter, const path_node_t *node) {
+  if (iter->num_pending == iter->pending_capacity) {
+    iter->pending_capacity *= 2;
+    iter->pending = (const path_node_t**)realloc(iter->pending,
+                                                 sizeof(path_node_t*)
+                                                 * iter->pending_capacity);
+  }
+  iter->pending[iter->num_pending++] = node;
+}
+
+void path_iter_init(path_iter_t *iter, const path_node_t *path) {
+  iter->pending_capacity = 64;
+  iter->pending = (const path_node_t**)malloc(sizeof(path_node_t*)
+                                              * iter->pending_capacity);
+  iter->num_pending = 0;
+  if (NULL != path)
+    path_iter_push(iter, path);
+}
+
+// Get the next segment of the path.  Returns false at the end of the
+// path.
+bool path_iter_next(path_iter_t *iter, int32_t *cs_index, uint64_t *length) {
+  if (0 == iter->num_pending)
+    return false;
+
+  const path_node_t *node = iter->pending[--iter->num_pending];
+  while (!path_segment_p(node)) {
+    path_iter_push(iter, node->right);
+    node = node->left;
+  }
+  *cs_index = node->cs_index;
+  *length = node->length;
+  return true;
+}
+
+void path_iter_free(path_iter_t *iter) {
+  free(iter->pending);
+  iter->pending = NULL;
+}
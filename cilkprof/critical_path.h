@@ -0,0 +1,44 @@
+#ifndef INCLUDED_CRITICAL_PATH_H
+#define INCLUDED_CRITICAL_PATH_H
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+// A path through the computation is a rope of segments, each a run of
+// consecutive strands in one call site.  A path is owned by exactly one
+// span variable, and concatenating two paths consumes both, so nodes
+// are never shared.
+typedef struct path_node_t {
+  // Call site of a segment, or -1 for the concatenation of left and
+  // right
+  int32_t cs_index;
+  // Total length of the path
+  uint64_t length;
+  // Parts of a concatenation.  For a node in the free pool, left links
+  // to the next free node.
+  struct path_node_t *left;
+  struct path_node_t *right;
+} path_node_t;
+
+// Iterator over the segments of a path, in order
+typedef struct {
+  // Roots of subpaths still to visit, innermost last
+  const path_node_t **pending;
+  int num_pending;
+  int pending_capacity;
+} path_iter_t;
+
+/**
+ * Exposed path methods
+ */
+path_node_t* path_append_segment(path_node_t *path, int32_t cs_index,
+                                 uint64_t length);
+path_node_t* path_concat(path_node_t *first, path_node_t *second);
+void path_free(path_node_t *path);
+void path_pool_free(void);
+
+void path_iter_init(path_iter_t *iter, const path_node_t *path);
+bool path_iter_next(path_iter_t *iter, int32_t *cs_index, uint64_t *length);
+void path_iter_free(path_iter_t *iter);
+
+#endif
@@ -10,10 +10,6 @@
 #define DEBUG_RESIZE 0
 #endif
 
-#ifndef IADDR_CACHE
-#define IADDR_CACHE 0
-#endif
-
 /**
  * Method implementations
  */
@@ -21,27 +17,27 @@
 static const int START_LG_CAPACITY = 4;
 
 #if IADDR_CACHE
-static const int IADDR_CACHE_SIZE = 8;
+// Number of lines in the direct-mapped cache, a power of 2
+static const int IADDR_CACHE_SIZE = 256;
 #endif
 
-// Use a standardish trick from hardware caching to hash rip.
-static const uint64_t TAG_OFFSET = 2;
-/* static const uint64_t PRIME = (uint32_t)(-5); */
-/* static const uint64_t ASEED = 0x8c678e6b; */
-/* static const uint64_t BSEED = 0x9c16f733; */
-/* static const int MIX_ROUNDS = 4; */
-
+// Instruction addresses are clustered, so mix their bits before
+// masking.
 static size_t hash(uintptr_t iaddr, int lg_capacity) {
   uint64_t mask = (1 << lg_capacity) - 1;
-  uint64_t key = (uint64_t)(iaddr >> TAG_OFFSET);
-  /* uint64_t h = (uint64_t)((ASEED * key + BSEED) % PRIME); */
-  /* for (int i = 0; i < MIX_ROUNDS; ++i) { */
-  /*   h = h * (2 * h + 1); */
-  /*   h = (h << (sizeof(h) / 2)) | (h >> (sizeof(h) / 2)); */
-  /* } */
-  uint64_t h = key;
-  return (size_t)(h & mask);
+  return (size_t)(mix_bits((uint64_t)iaddr) & mask);
+}
+
+#if IADDR_CACHE
+// Line of the cache for iaddr and func_type.  User-space addresses fit
+// in 48 bits, so func_type goes in the bits above.
+static inline iaddr_cache_line_t*
+iaddr_cache_line(const iaddr_table_t *tab, uintptr_t iaddr,
+                 FunctionType_t func_type) {
+  uint64_t key = (uint64_t)iaddr ^ ((uint64_t)func_type << 48);
+  return &(tab->iaddr_cache[mix_bits(key) & (IADDR_CACHE_SIZE - 1)]);
 }
+#endif
 
 
 // Return true if this entry is empty, false otherwise.
@@ -83,18 +79,10 @@ static iaddr_table_t* iaddr_table_alloc(int lg_capacity) {
 iaddr_table_t* iaddr_table_create(void) {
   iaddr_table_t *tab = iaddr_table_alloc(START_LG_CAPACITY);
 #if IADDR_CACHE
+  // Lines with a NULL iaddr are empty, since NULL is never looked up.
   tab->iaddr_cache
-      = (iaddr_cache_el_t*)malloc(sizeof(iaddr_cache_el_t)
-                                      * IADDR_CACHE_SIZE);
-  // Initialize cache
-  iaddr_cache_el_t *cache_el = tab->iaddr_cache;
-  for (int i = 0; i < IADDR_CACHE_SIZE - 1; ++i) {
-    cache_el->next = cache_el + 1;
-    cache_el->record = NULL;
-    cache_el = cache_el->next;
-  }
-  cache_el->next = NULL;
-  cache_el->record = NULL;
+      = (iaddr_cache_line_t*)calloc(IADDR_CACHE_SIZE,
+                                    sizeof(iaddr_cache_line_t));
 #endif
   return tab;
 }
@@ -107,32 +95,7 @@ get_iaddr_record_const(uintptr_t iaddr, FunctionType_t func_type, iaddr_table_t
 
   assert((uintptr_t)NULL != iaddr);
 
-#if IADDR_CACHE
-  // Search for call site in cache
-  iaddr_cache_el_t *cache_el = tab->iaddr_cache;
-  iaddr_cache_el_t *last_cache_el = NULL;
-  while (NULL != cache_el->record) {
-    if ((iaddr == cache_el->record->iaddr) &
-        (func_type == cache_el->record->func_type)) {
-      // Move record to front of cache
-      if (NULL != last_cache_el) {
-        last_cache_el->next = cache_el->next;
-        cache_el->next = tab->iaddr_cache;
-        tab->iaddr_cache = cache_el;
-      }
-      return cache_el->record;
-    }
-    if (NULL == cache_el->next) {
-      // No more elements in cache
-      break;
-    }
-    last_cache_el = cache_el;
-    cache_el = cache_el->next;
-  }
-#endif
-
-  // Call site not found in cache.  Hash the call site and search the
-  // table.
+  // Hash the call site and search the table.
   iaddr_record_t **first_record = &(tab->records[hash(iaddr, tab->lg_capacity)]);
 
   // Scan linked list
@@ -159,17 +122,6 @@ get_iaddr_record_const(uintptr_t iaddr, FunctionType_t func_type, iaddr_table_t
   last_record->next = record->next;
   record->next = *first_record;
   *first_record = record;
-  
-#if IADDR_CACHE
-  // Place record at front of cache
-  cache_el->record = record;
-  // Move record to front of cache
-  if (NULL != last_cache_el) {
-    last_cache_el->next = cache_el->next;
-    cache_el->next = tab->iaddr_cache;
-    tab->iaddr_cache = cache_el;
-  }
-#endif
 
   return record;
 }
@@ -240,9 +192,23 @@ get_iaddr_record(uintptr_t iaddr, FunctionType_t func_type, iaddr_table_t **tab)
 __attribute__((always_inline))
 int32_t add_to_iaddr_table(iaddr_table_t **tab, uintptr_t iaddr, FunctionType_t func_type) {
 
+#if IADDR_CACHE
+  iaddr_cache_line_t *line = iaddr_cache_line(*tab, iaddr, func_type);
+  if ((iaddr == line->iaddr) & (func_type == line->func_type))
+    return line->index;
+#endif
+
   iaddr_record_t *record = get_iaddr_record(iaddr, func_type, tab);
   assert(NULL != record);
-  
+
+#if IADDR_CACHE
+  // The cache is shared by all sizes of the table, so line is still
+  // valid if the table grew.
+  line->iaddr = iaddr;
+  line->func_type = func_type;
+  line->index = record->index;
+#endif
+
   /* if (empty_record_p(record)) { */
   /*   record->iaddr = iaddr; */
   /*   record->func_type = func_type; */
@@ -273,15 +239,7 @@ void iaddr_table_free(iaddr_table_t *tab) {
   }
 
 #if IADDR_CACHE
-  iaddr_cache_el_t *cache_el = tab->iaddr_cache;
-  iaddr_cache_el_t *cache_start = cache_el;
-  while (NULL != cache_el) {
-    if ((uintptr_t)cache_el < (uintptr_t)cache_start) {
-      cache_start = cache_el;
-    }
-    cache_el = cache_el->next;
-  }
-  free(cache_start);
+  free(tab->iaddr_cache);
 #endif
 
   free(tab);
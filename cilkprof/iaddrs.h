@@ -1,8 +1,10 @@
 #ifndef INCLUDED_IADDRS_H
 #define INCLUDED_IADDRS_H
 
+// Set IADDR_CACHE to 1 to resolve repeated lookups through a
+// direct-mapped cache in front of the table.
 #ifndef IADDR_CACHE
-#define IADDR_CACHE 0
+#define IADDR_CACHE 1
 #endif
 
 #include <stdbool.h>
@@ -24,15 +26,19 @@ typedef struct iaddr_record_t {
 } iaddr_record_t;
 
 #if IADDR_CACHE
-typedef struct iaddr_cache_el_t {
-  iaddr_record_t *record;
-  struct iaddr_cache_el_t *next;
-} iaddr_cache_el_t;
+// Line of the direct-mapped cache, holding the index of a record
+typedef struct {
+  uintptr_t iaddr;
+  FunctionType_t func_type;
+  int32_t index;
+} iaddr_cache_line_t;
 #endif
 
 typedef struct {
 #if IADDR_CACHE
-  iaddr_cache_el_t* iaddr_cache;
+  // Cache of recently resolved records, which is kept across resizes
+  // of the table
+  iaddr_cache_line_t* iaddr_cache;
 #endif
   int lg_capacity;
   int table_size;
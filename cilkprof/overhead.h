@@ -0,0 +1,88 @@
+#ifndef INCLUDED_OVERHEAD_H
+#define INCLUDED_OVERHEAD_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Set CALIBRATE_OVERHEAD to 1 to subtract the overhead of the tool's
+// hooks from every measured strand.  Each strand is measured from the
+// end of one hook to the start of the next, so it includes the return
+// from the first hook and the entry into the second.  The overhead per
+// strand is calibrated at startup, or read from CILKPROF_OVERHEAD in
+// the units of the strand ruler.  Rulers that count strands, rather
+// than time them, have no overhead to subtract.
+#ifndef CALIBRATE_OVERHEAD
+#define CALIBRATE_OVERHEAD 1
+#endif
+
+#if !STRAND_LENGTH_IS_TIME
+#undef CALIBRATE_OVERHEAD
+#define CALIBRATE_OVERHEAD 0
+#endif
+
+#if CALIBRATE_OVERHEAD
+#define WHEN_CALIBRATE_OVERHEAD(ex) do { ex } while (0)
+#else
+#define WHEN_CALIBRATE_OVERHEAD(ex) do {} while (0)
+#endif
+
+#if CALIBRATE_OVERHEAD
+// Number of empty strands measured by the calibration
+static const int OVERHEAD_SAMPLES = 10001;
+
+// Estimate of the overhead included in the length of a strand
+typedef struct {
+  // Median length of an empty strand
+  uint64_t per_strand;
+  // Half of the interquartile range of the lengths of empty strands,
+  // which bounds the typical error of the correction of one strand
+  uint64_t error;
+} overhead_t;
+
+// End the strand measured by strand_ruler and start the next, as a
+// hook does.  Returns the length of the strand that ended.
+static __attribute__((noinline))
+uint64_t overhead_calibration_hook(strand_ruler_t *strand_ruler) {
+  uint64_t strand_len = measure_strand_length(strand_ruler);
+  start_strand(strand_ruler);
+  return strand_len;
+}
+
+static int compare_strand_lengths(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+// Measure the overhead per strand with strand_ruler by timing empty
+// strands between consecutive calls to a hook.
+static overhead_t calibrate_overhead(strand_ruler_t *strand_ruler) {
+  // Call the hook through a volatile pointer, so that every call is a
+  // real call, like the calls the compiler inserts.
+  uint64_t (*volatile hook)(strand_ruler_t*) = overhead_calibration_hook;
+  uint64_t *samples = (uint64_t*)malloc(sizeof(uint64_t) * OVERHEAD_SAMPLES);
+
+  start_strand(strand_ruler);
+  for (int i = 0; i < OVERHEAD_SAMPLES; ++i) {
+    samples[i] = hook(strand_ruler);
+  }
+  qsort(samples, OVERHEAD_SAMPLES, sizeof(uint64_t), compare_strand_lengths);
+
+  overhead_t overhead;
+  overhead.per_strand = samples[OVERHEAD_SAMPLES / 2];
+  overhead.error = (samples[3 * OVERHEAD_SAMPLES / 4]
+                    - samples[OVERHEAD_SAMPLES / 4]) / 2;
+  free(samples);
+  return overhead;
+}
+
+// Return strand_len with the overhead removed.  A strand is never
+// shorter than one unit, so that every measured function has nonzero
+// work.
+static inline uint64_t remove_overhead(uint64_t strand_len,
+                                       const overhead_t *overhead) {
+  return (strand_len > overhead->per_strand) ?
+    strand_len - overhead->per_strand : 1;
+}
+#endif
+
+#endif
@@ -0,0 +1,299 @@
+#include "profile_formats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <libgen.h>
+
+// Writers of the call-site profile in formats read by standard
+// viewers.  Each call site becomes a single frame whose values are its
+// local work on work and its local work on span, which exclude the
+// work of its callees, as self values in these viewers do.  The
+// writers stream the profile from the tables, one call site at a time.
+
+// Parse CILKPROF_OUTPUT_FORMAT into a set of output_format_t flags.
+int read_output_formats(void) {
+  const char *e = getenv("CILKPROF_OUTPUT_FORMAT");
+  if (NULL == e)
+    return OUTPUT_CSV;
+
+  int formats = 0;
+  char *list = strdup(e);
+  for (char *format = strtok(list, ","); NULL != format;
+       format = strtok(NULL, ",")) {
+    if (0 == strcmp(format, "csv"))
+      formats |= OUTPUT_CSV;
+    else if (0 == strcmp(format, "pprof"))
+      formats |= OUTPUT_PPROF;
+    else if (0 == strcmp(format, "speedscope"))
+      formats |= OUTPUT_SPEEDSCOPE;
+    else
+      fprintf(stderr, "cilkprof: unknown output format \"%s\"\n", format);
+  }
+  free(list);
+  return formats;
+}
+
+// Return the entry of table for the call site with the given index, or
+// NULL if the table has no data for it.
+static inline const cc_hashtable_entry_t*
+profiled_entry(const cc_hashtable_t *table, int32_t index) {
+  if (index >= (1 << table->lg_capacity))
+    return NULL;
+  const cc_hashtable_entry_t *entry = &(table->entries[index]);
+  if (empty_cc_entry_p(table, entry))
+    return NULL;
+  return entry;
+}
+
+// Describe the call site of record in label, and set *addr, *line and
+// *file to its address and source location.  Returns a buffer to free
+// after *file is used, like get_info_on_inst_addr.
+static char* describe_call_site(const cilkprof_stack_t *stack,
+                                const iaddr_record_t *record,
+                                char *label, size_t label_size,
+                                uint64_t *addr, int *line, const char **file) {
+  char *fstr = NULL;
+  *line = 0;
+  *addr = rip2cc(record->iaddr);
+  char *line_to_free = get_info_on_inst_addr(*addr, line, &fstr);
+  *file = (NULL != fstr) ? basename(fstr) : "??";
+  snprintf(label, label_size, "%s:%d %s%s", *file, *line,
+           FunctionType_str[record->func_type],
+           (stack->cs_status[record->index].flags & RECURSIVE) ? " recursive" : "");
+  return line_to_free;
+}
+
+/*************************************************************************/
+/**
+ * pprof protobuf writer, following profile.proto of
+ * github.com/google/pprof.  The output is not compressed, which pprof
+ * accepts.
+ */
+
+// Wire types
+static const int PB_VARINT = 0;
+static const int PB_BYTES = 2;
+
+// Fields of Profile
+static const int PROFILE_SAMPLE_TYPE = 1;
+static const int PROFILE_SAMPLE = 2;
+static const int PROFILE_LOCATION = 4;
+static const int PROFILE_FUNCTION = 5;
+static const int PROFILE_STRING_TABLE = 6;
+
+// Every message nested in Profile fits in this many bytes.
+#define PB_MSG_MAX 128
+
+// Buffer for encoding one message nested in Profile
+typedef struct {
+  uint8_t data[PB_MSG_MAX];
+  size_t len;
+} pb_buf_t;
+
+static void pb_varint(pb_buf_t *buf, uint64_t v) {
+  while (v >= 0x80) {
+    buf->data[buf->len++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  buf->data[buf->len++] = (uint8_t)v;
+}
+
+static void pb_uint(pb_buf_t *buf, int field, uint64_t v) {
+  pb_varint(buf, ((uint64_t)field << 3) | PB_VARINT);
+  pb_varint(buf, v);
+}
+
+static void pb_message(pb_buf_t *buf, int field, const pb_buf_t *msg) {
+  pb_varint(buf, ((uint64_t)field << 3) | PB_BYTES);
+  pb_varint(buf, msg->len);
+  assert(buf->len + msg->len <= PB_MSG_MAX);
+  memcpy(buf->data + buf->len, msg->data, msg->len);
+  buf->len += msg->len;
+}
+
+// Write a length-delimited field of Profile to fout.
+static void pb_write_bytes(FILE *fout, int field, const void *data, size_t len) {
+  pb_buf_t header = { .len = 0 };
+  pb_varint(&header, ((uint64_t)field << 3) | PB_BYTES);
+  pb_varint(&header, len);
+  fwrite(header.data, 1, header.len, fout);
+  fwrite(data, 1, len, fout);
+}
+
+// Append str to the string table and return its index.
+static int64_t pb_write_string(FILE *fout, int64_t *num_strings, const char *str) {
+  pb_write_bytes(fout, PROFILE_STRING_TABLE, str, strlen(str));
+  return (*num_strings)++;
+}
+
+static void pb_write_sample_type(FILE *fout, int64_t *num_strings,
+                                 const char *type, const char *unit) {
+  pb_buf_t value_type = { .len = 0 };
+  pb_uint(&value_type, 1, pb_write_string(fout, num_strings, type));
+  pb_uint(&value_type, 2, pb_write_string(fout, num_strings, unit));
+  pb_write_bytes(fout, PROFILE_SAMPLE_TYPE, value_type.data, value_type.len);
+}
+
+// Print the call-site data in work_table and span_table to fout as a
+// pprof profile, with sample types work, span and calls.
+void print_call_site_pprof(FILE *fout, const cilkprof_stack_t *stack,
+                           const cc_hashtable_t *work_table,
+                           const cc_hashtable_t *span_table) {
+  // The string table must start with "".
+  int64_t num_strings = 0;
+  pb_write_string(fout, &num_strings, "");
+  pb_write_sample_type(fout, &num_strings, "work", STRAND_UNIT);
+  pb_write_sample_type(fout, &num_strings, "span", STRAND_UNIT);
+  pb_write_sample_type(fout, &num_strings, "calls", "count");
+
+  uint64_t id = 0;
+  char label[PATH_MAX + 64];
+  for (size_t i = 0; i < (1 << (call_site_table->lg_capacity)); ++i) {
+    for (const iaddr_record_t *record = call_site_table->records[i];
+         NULL != record; record = record->next) {
+      const cc_hashtable_entry_t *entry = profiled_entry(work_table, record->index);
+      if (NULL == entry)
+        continue;
+      const cc_hashtable_entry_t *span_entry = profiled_entry(span_table, record->index);
+      ++id;
+
+      uint64_t addr;
+      int line;
+      const char *file;
+      char *line_to_free = describe_call_site(stack, record, label, sizeof(label),
+                                              &addr, &line, &file);
+      int64_t name = pb_write_string(fout, &num_strings, label);
+      int64_t filename = pb_write_string(fout, &num_strings, file);
+      if (line_to_free) free(line_to_free);
+
+      // Function and location share the id of the call site.
+      pb_buf_t function = { .len = 0 };
+      pb_uint(&function, 1, id);
+      pb_uint(&function, 2, name);
+      pb_uint(&function, 3, name);
+      pb_uint(&function, 4, filename);
+      pb_uint(&function, 5, line);
+      pb_write_bytes(fout, PROFILE_FUNCTION, function.data, function.len);
+
+      pb_buf_t line_msg = { .len = 0 };
+      pb_uint(&line_msg, 1, id);
+      pb_uint(&line_msg, 2, line);
+      pb_buf_t location = { .len = 0 };
+      pb_uint(&location, 1, id);
+      pb_uint(&location, 3, addr);
+      pb_message(&location, 4, &line_msg);
+      pb_write_bytes(fout, PROFILE_LOCATION, location.data, location.len);
+
+      pb_buf_t location_ids = { .len = 0 };
+      pb_varint(&location_ids, id);
+      pb_buf_t values = { .len = 0 };
+      pb_varint(&values, entry->local_wrk);
+      pb_varint(&values, (NULL != span_entry) ? span_entry->local_wrk : 0);
+      pb_varint(&values, entry->local_count);
+      pb_buf_t sample = { .len = 0 };
+      pb_message(&sample, 1, &location_ids);
+      pb_message(&sample, 2, &values);
+      pb_write_bytes(fout, PROFILE_SAMPLE, sample.data, sample.len);
+    }
+  }
+}
+
+/*************************************************************************/
+/**
+ * speedscope JSON writer, following
+ * https://www.speedscope.app/file-format-schema.json.  The profile
+ * holds one sampled profile each for work and span.
+ */
+
+static void json_write_string(FILE *fout, const char *str) {
+  fputc('"', fout);
+  for (; '\0' != *str; ++str) {
+    if ('"' == *str || '\\' == *str)
+      fputc('\\', fout);
+    if ((unsigned char)*str < 0x20)
+      fprintf(fout, "\\u%04x", *str);
+    else
+      fputc(*str, fout);
+  }
+  fputc('"', fout);
+}
+
+// Print one sampled profile with a sample of each call site, weighted
+// by its local work in table.  Call sites are visited in the same order
+// as their frames were printed.
+static void speedscope_write_profile(FILE *fout, const char *name,
+                                     const cc_hashtable_t *work_table,
+                                     const cc_hashtable_t *table) {
+  // speedscope only knows units of time and bytes.
+  const char *unit = (0 == strcmp(STRAND_UNIT, "nanoseconds")) ? "nanoseconds" : "none";
+  fprintf(fout, "{\"type\":\"sampled\",\"name\":\"%s\",\"unit\":\"%s\",\"startValue\":0,",
+          name, unit);
+
+  fprintf(fout, "\"samples\":[");
+  int frame = 0;
+  for (size_t i = 0; i < (1 << (call_site_table->lg_capacity)); ++i) {
+    for (const iaddr_record_t *record = call_site_table->records[i];
+         NULL != record; record = record->next) {
+      if (NULL == profiled_entry(work_table, record->index))
+        continue;
+      fprintf(fout, "%s[%d]", (0 == frame) ? "" : ",", frame);
+      ++frame;
+    }
+  }
+
+  fprintf(fout, "],\"weights\":[");
+  uint64_t total = 0;
+  frame = 0;
+  for (size_t i = 0; i < (1 << (call_site_table->lg_capacity)); ++i) {
+    for (const iaddr_record_t *record = call_site_table->records[i];
+         NULL != record; record = record->next) {
+      if (NULL == profiled_entry(work_table, record->index))
+        continue;
+      const cc_hashtable_entry_t *entry = profiled_entry(table, record->index);
+      uint64_t weight = (NULL != entry) ? entry->local_wrk : 0;
+      fprintf(fout, "%s%lu", (0 == frame) ? "" : ",", weight);
+      total += weight;
+      ++frame;
+    }
+  }
+  fprintf(fout, "],\"endValue\":%lu}", total);
+}
+
+// Print the call-site data in work_table and span_table to fout as a
+// speedscope profile.
+void print_call_site_speedscope(FILE *fout, const cilkprof_stack_t *stack,
+                                const cc_hashtable_t *work_table,
+                                const cc_hashtable_t *span_table) {
+  fprintf(fout, "{\"$schema\":\"https://www.speedscope.app/file-format-schema.json\",");
+  fprintf(fout, "\"exporter\":\"cilkprof\",\"name\":\"cilkprof\",");
+
+  fprintf(fout, "\"shared\":{\"frames\":[");
+  int frame = 0;
+  char label[PATH_MAX + 64];
+  for (size_t i = 0; i < (1 << (call_site_table->lg_capacity)); ++i) {
+    for (const iaddr_record_t *record = call_site_table->records[i];
+         NULL != record; record = record->next) {
+      if (NULL == profiled_entry(work_table, record->index))
+        continue;
+      uint64_t addr;
+      int line;
+      const char *file;
+      char *line_to_free = describe_call_site(stack, record, label, sizeof(label),
+                                              &addr, &line, &file);
+      fprintf(fout, "%s{\"name\":", (0 == frame) ? "" : ",");
+      json_write_string(fout, label);
+      fprintf(fout, ",\"file\":");
+      json_write_string(fout, file);
+      fprintf(fout, ",\"line\":%d}", line);
+      if (line_to_free) free(line_to_free);
+      ++frame;
+    }
+  }
+  fprintf(fout, "]},");
+
+  fprintf(fout, "\"profiles\":[");
+  speedscope_write_profile(fout, "work", work_table, work_table);
+  fprintf(fout, ",");
+  speedscope_write_profile(fout, "span", work_table, span_table);
+  fprintf(fout, "]}\n");
+}
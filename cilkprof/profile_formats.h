@@ -0,0 +1,27 @@
+#ifndef INCLUDED_PROFILE_FORMATS_H
+#define INCLUDED_PROFILE_FORMATS_H
+
+#include <stdio.h>
+
+#include "cilkprof_stack.h"
+
+// Formats of the call-site profile, selected by a comma-separated list
+// in CILKPROF_OUTPUT_FORMAT.  The default is OUTPUT_CSV.
+typedef enum {
+  OUTPUT_CSV = 1,
+  OUTPUT_PPROF = 2,
+  OUTPUT_SPEEDSCOPE = 4,
+} output_format_t;
+
+/**
+ * Exposed profile writer methods
+ */
+int read_output_formats(void);
+void print_call_site_pprof(FILE *fout, const cilkprof_stack_t *stack,
+                           const cc_hashtable_t *work_table,
+                           const cc_hashtable_t *span_table);
+void print_call_site_speedscope(FILE *fout, const cilkprof_stack_t *stack,
+                                const cc_hashtable_t *work_table,
+                                const cc_hashtable_t *span_table);
+
+#endif
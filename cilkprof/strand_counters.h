@@ -0,0 +1,43 @@
+#ifndef INCLUDED_STRAND_COUNTERS_H
+#define INCLUDED_STRAND_COUNTERS_H
+
+#include <inttypes.h>
+
+// Set STRAND_PERF to 1 to measure strands with the hardware-counter
+// ruler in strand_perf.h.  Besides cycles, which remain the primary
+// strand length, that ruler reports the additional counters below for
+// every strand, and cilkprof accumulates them into extra work and span
+// columns.
+#ifndef STRAND_PERF
+#define STRAND_PERF 0
+#endif
+
+#if STRAND_PERF
+#define WHEN_STRAND_PERF(ex) do { ex } while (0)
+
+// Number of hardware counters read alongside cycles
+#define NUM_STRAND_COUNTERS 2
+
+// Vector of counter values associated with a strand, or a sum of
+// strands
+typedef struct {
+  uint64_t c[NUM_STRAND_COUNTERS];
+} strand_counters_t;
+
+static inline void clear_strand_counters(strand_counters_t *dst) {
+  for (int i = 0; i < NUM_STRAND_COUNTERS; ++i) {
+    dst->c[i] = 0;
+  }
+}
+
+static inline void add_strand_counters(strand_counters_t *dst,
+                                       const strand_counters_t *src) {
+  for (int i = 0; i < NUM_STRAND_COUNTERS; ++i) {
+    dst->c[i] += src->c[i];
+  }
+}
+#else
+#define WHEN_STRAND_PERF(ex) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+#include "strand_ids.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/**
+ * Method implementations
+ */
+// Starting capacity of the hash table is 2^6 slots.
+static const int START_STRAND_LG_CAPACITY = 6;
+
+int MIN_STRAND_CAPACITY = 1;
+
+// Mix the bits of both endpoints of a strand into a hash value.
+static inline size_t hash_strand(uintptr_t start, uintptr_t end,
+                                 int lg_capacity) {
+  uint64_t h = mix_bits((uint64_t)start ^
+                        ((uint64_t)end << 32 | (uint64_t)end >> 32));
+  return (size_t)(h & ((1 << lg_capacity) - 1));
+}
+
+
+// Create a new, empty table.  Returns a pointer to the table created.
+strand_id_table_t* strand_id_table_create(void) {
+  strand_id_table_t *tab = (strand_id_table_t*)malloc(sizeof(strand_id_table_t));
+  size_t capacity = 1 << START_STRAND_LG_CAPACITY;
+
+  tab->lg_capacity = START_STRAND_LG_CAPACITY;
+  tab->table_size = 0;
+  tab->slots = (int32_t*)calloc(capacity, sizeof(int32_t));
+  tab->strands_capacity = capacity / 2;
+  tab->strands = (strand_endpoints_t*)malloc(sizeof(strand_endpoints_t)
+                                             * tab->strands_capacity);
+  return tab;
+}
+
+
+// Double the number of slots of tab, rehashing the strands.
+static void increase_strand_table_capacity(strand_id_table_t *tab) {
+  int new_lg_capacity = tab->lg_capacity + 1;
+  size_t new_capacity = 1 << new_lg_capacity;
+  size_t mask = new_capacity - 1;
+  int32_t *new_slots = (int32_t*)calloc(new_capacity, sizeof(int32_t));
+
+  for (int32_t i = 0; i < tab->table_size; ++i) {
+    size_t slot = hash_strand(tab->strands[i].start, tab->strands[i].end,
+                              new_lg_capacity);
+    while (0 != new_slots[slot])
+      slot = (slot + 1) & mask;
+    new_slots[slot] = i + 1;
+  }
+
+  free(tab->slots);
+  tab->slots = new_slots;
+  tab->lg_capacity = new_lg_capacity;
+
+  tab->strands_capacity = new_capacity / 2;
+  tab->strands = (strand_endpoints_t*)realloc(tab->strands,
+                                              sizeof(strand_endpoints_t)
+                                              * tab->strands_capacity);
+}
+
+
+// Return the index of the strand from start to end, adding the strand
+// to **tab if necessary.
+__attribute__((always_inline))
+int32_t add_to_strand_id_table(strand_id_table_t **tab,
+                               uintptr_t start, uintptr_t end) {
+  strand_id_table_t *t = *tab;
+  size_t mask = (1 << t->lg_capacity) - 1;
+  size_t slot = hash_strand(start, end, t->lg_capacity);
+
+  // Linear probing
+  int32_t id;
+  while (0 != (id = t->slots[slot])) {
+    const strand_endpoints_t *strand = &(t->strands[id - 1]);
+    if ((start == strand->start) & (end == strand->end))
+      return id - 1;
+    slot = (slot + 1) & mask;
+  }
+
+  // Grow table if capacity exceeds 50%
+  if (t->table_size + 1 > t->strands_capacity) {
+    increase_strand_table_capacity(t);
+    mask = (1 << t->lg_capacity) - 1;
+    slot = hash_strand(start, end, t->lg_capacity);
+    while (0 != t->slots[slot])
+      slot = (slot + 1) & mask;
+  }
+
+  int32_t index = t->table_size++;
+  t->strands[index].start = start;
+  t->strands[index].end = end;
+  t->slots[slot] = index + 1;
+
+  if (index >= MIN_STRAND_CAPACITY)
+    MIN_STRAND_CAPACITY = index + 1;
+
+  return index;
+}
+
+void strand_id_table_free(strand_id_table_t *tab) {
+  free(tab->slots);
+  free(tab->strands);
+  free(tab);
+}
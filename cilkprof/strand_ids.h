@@ -0,0 +1,52 @@
+#ifndef INCLUDED_STRAND_IDS_H
+#define INCLUDED_STRAND_IDS_H
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+// Endpoints of a strand
+typedef struct {
+  // Start of strand
+  uintptr_t start;
+  // End of strand
+  uintptr_t end;
+} strand_endpoints_t;
+
+// Table that interns strands, identified by their endpoints, to dense
+// indices.  The work and span of strands are then stored in
+// cc_hashtable_t instances indexed by these indices.
+typedef struct {
+  // Lg of capacity of the open-addressed slots
+  int lg_capacity;
+
+  // Number of strands in the table
+  int table_size;
+
+  // Capacity of strands[]
+  int strands_capacity;
+
+  // Slots of the hash table, storing 1 + index of a strand, or 0 if
+  // the slot is empty.
+  int32_t *slots;
+
+  // Endpoints of each strand, indexed by strand index
+  strand_endpoints_t *strands;
+} strand_id_table_t;
+
+// One more than the largest strand index handed out so far.  This
+// bounds the cc_hashtable_t instances storing strand data.
+extern int MIN_STRAND_CAPACITY;
+
+/**
+ * Exposed strand table methods
+ */
+strand_id_table_t* strand_id_table_create(void);
+int32_t add_to_strand_id_table(strand_id_table_t **tab,
+                               uintptr_t start, uintptr_t end);
+void strand_id_table_free(strand_id_table_t *tab);
+
+#endif
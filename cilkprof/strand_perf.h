@@ -0,0 +1,123 @@
+#ifndef INCLUDED_STRAND_TIME_DOT_H
+#define INCLUDED_STRAND_TIME_DOT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "strand_counters.h"
+
+// Strand ruler that reads a group of hardware counters with a single
+// read() per measurement.  The group leader counts cycles, which is
+// the strand length returned by measure_strand_length().  The
+// remaining members are exposed through strand_ruler->counts.
+
+// Total number of events in the group, including the cycle leader
+#define NUM_STRAND_EVENTS (NUM_STRAND_COUNTERS + 1)
+
+static const struct {
+  uint32_t type;
+  uint64_t config;
+} strand_events[NUM_STRAND_EVENTS] = {
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+};
+
+static const char *strand_counter_names[NUM_STRAND_COUNTERS] = {
+  "instructions",
+  "llc misses",
+};
+
+typedef struct strand_ruler_t {
+  // File descriptors of the events; fd[0] is the group leader
+  int fd[NUM_STRAND_EVENTS];
+
+  // Layout of a PERF_FORMAT_GROUP read: nr, followed by nr values
+  uint64_t start[NUM_STRAND_EVENTS + 1];
+  uint64_t stop[NUM_STRAND_EVENTS + 1];
+
+  // Counter deltas of the last measured strand
+  strand_counters_t counts;
+} strand_ruler_t;
+
+
+static inline int perf_event_open(struct perf_event_attr *attr, pid_t pid,
+                                  int cpu, int group_fd, unsigned long flags) {
+  return syscall(__NR_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+// Read all counters of the group into VALUES.
+static inline void gettime(const strand_ruler_t *strand_ruler, uint64_t *values) {
+  ssize_t size = sizeof(uint64_t) * (NUM_STRAND_EVENTS + 1);
+  if (read(strand_ruler->fd[0], values, size) != size) {
+    err(1, "cannot read strand counters");
+  }
+}
+
+static inline void init_strand_ruler(strand_ruler_t *strand_ruler) {
+  struct perf_event_attr attr;
+  for (int i = 0; i < NUM_STRAND_EVENTS; ++i) {
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = strand_events[i].type;
+    attr.config = strand_events[i].config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.disabled = (0 == i);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    int group_fd = (0 == i) ? -1 : strand_ruler->fd[0];
+    strand_ruler->fd[i] = perf_event_open(&attr, 0, -1, group_fd, 0);
+    if (strand_ruler->fd[i] < 0) {
+      err(1, "cannot open strand counter %d", i);
+    }
+  }
+  clear_strand_counters(&(strand_ruler->counts));
+  ioctl(strand_ruler->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static inline void start_strand(strand_ruler_t *strand_ruler) {
+  gettime(strand_ruler, strand_ruler->start);
+}
+
+static inline void stop_strand(strand_ruler_t *strand_ruler) {
+  gettime(strand_ruler, strand_ruler->stop);
+}
+
+static inline uint64_t measure_strand_length(strand_ruler_t *strand_ruler) {
+  // End of strand
+  stop_strand(strand_ruler);
+  assert(NUM_STRAND_EVENTS == strand_ruler->stop[0]);
+  for (int i = 0; i < NUM_STRAND_COUNTERS; ++i) {
+    strand_ruler->counts.c[i] = strand_ruler->stop[i + 2] - strand_ruler->start[i + 2];
+  }
+  return strand_ruler->stop[1] - strand_ruler->start[1];
+}
+
+// Unit of strand lengths
+#define STRAND_UNIT "cycles"
+// Strand lengths are times, which include the overhead of the hooks.
+#define STRAND_LENGTH_IS_TIME 1
+
+static inline void print_work_span(uint64_t work, uint64_t span) {
+  fprintf(stderr, "work %f Gcycles, span %f Gcycles, parallelism %f\n",
+          work / (1000000000.0),
+          span / (1000000000.0),
+          work / (float)span);
+}
+
+static inline void print_counters_work_span(const strand_counters_t *work,
+                                            const strand_counters_t *span) {
+  for (int i = 0; i < NUM_STRAND_COUNTERS; ++i) {
+    fprintf(stderr, "%s: work %lu, span %lu, parallelism %f\n",
+            strand_counter_names[i], work->c[i], span->c[i],
+            work->c[i] / (float)span->c[i]);
+  }
+}
+
+#endif
@@ -46,6 +46,11 @@ static inline uint64_t measure_strand_length(strand_ruler_t *strand_ruler) {
   return elapsed_nsec(&(strand_ruler->start), &(strand_ruler->stop));
 }
 
+// Unit of strand lengths
+#define STRAND_UNIT "nanoseconds"
+// Strand lengths are times, which include the overhead of the hooks.
+#define STRAND_LENGTH_IS_TIME 1
+
 static inline void print_work_span(uint64_t work, uint64_t span) {
   fprintf(stderr, "work %fs, span %fs, parallelism %f\n",
           work / (1000000000.0),
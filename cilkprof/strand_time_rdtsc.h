@@ -60,6 +60,11 @@ static inline uint64_t measure_strand_length(strand_ruler_t *strand_ruler) {
   /*     - ((uint64_t)(strand_ruler->start_lo) + ((uint64_t)(strand_ruler->start_hi) << 32)); */
 }
 
+// Unit of strand lengths
+#define STRAND_UNIT "cycles"
+// Strand lengths are times, which include the overhead of the hooks.
+#define STRAND_LENGTH_IS_TIME 1
+
 static inline void print_work_span(uint64_t work, uint64_t span) {
   fprintf(stderr, "work %f Gcycles, span %f Gcycles, parallelism %f\n",
           work / (1000000000.0),
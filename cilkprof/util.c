@@ -49,10 +49,12 @@ void read_proc_maps(void) {
     uintptr_t start, end;
     char c0, c1, c2, c3;
     int off, major, minor, inode;
-    char *pathname;
+    char *pathname = NULL;
     sscanf(lineptr, "%lx-%lx %c%c%c%c %x %x:%x %x %ms",
 	   &start, &end, &c0, &c1, &c2, &c3, &off, &major, &minor, &inode, &pathname);
     if (0) printf(" start=%lx end=%lx path=%s\n", start, end, pathname);
+    // Skip anonymous mappings, which have no file to look up
+    if (NULL == pathname) continue;
     // Make new map
     mapping_list_el_t *m = (mapping_list_el_t*)malloc(sizeof(mapping_list_el_t));
     m->map.low = start;
@@ -65,12 +67,27 @@ void read_proc_maps(void) {
       maps.tail = m;
     } else {
       maps.tail->next = m;
+      maps.tail = m;
     }
   }
   /* if (0) printf("maps.size()=%lu\n", maps->size()); */
+  free(lineptr);
   fclose(f);
 }
 
+void free_proc_maps(void) {
+  mapping_list_el_t *map_lst_el = maps.head;
+  mapping_list_el_t *next_map_lst_el;
+  while (NULL != map_lst_el) {
+    next_map_lst_el = map_lst_el->next;
+    free(map_lst_el->map.path);
+    free(map_lst_el);
+    map_lst_el = next_map_lst_el;
+  }
+  maps.head = NULL;
+  maps.tail = NULL;
+}
+
 // The user of this function should free the char * returned after you are
 // done with the info.
 char* get_info_on_inst_addr(uint64_t addr, int *line_no, char **file) {
@@ -24,6 +24,13 @@ typedef enum {
 
 extern const char *FunctionType_str[FUNCTIONTYPE_END];
 
+// Mix the bits of x for hashing, using the finalizer from splitmix64.
+static inline uint64_t mix_bits(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
 // Linked list of mappings.
 typedef struct mapping_t {
   uintptr_t low, high;
@@ -46,6 +53,7 @@ extern mapping_list_t maps;
 void ensure_serial_tool(void);
 uintptr_t rip2cc(uintptr_t rip);
 void read_proc_maps(void);
+void free_proc_maps(void);
 char* get_info_on_inst_addr(uint64_t addr, int *line_no, char **file);
 void print_addr(uintptr_t a);
 
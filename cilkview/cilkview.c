@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -6,25 +7,35 @@
 #include <inttypes.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <link.h>
 
 /* #include <cilk/common.h> */
 /* #include <internal/abi.h> */
 
 #include <cilktool.h>
+#include <speedup.h>
 
 #include "context_stack.h"
+#include "tsc_clock.h"
 
+// Set SERIAL_TOOL to 0, or build with PARALLEL=1, to measure the
+// program while it runs on all workers.  Each worker then updates its
+// own view of the context stack, and the views are combined by
+// reduce_context_stack as the runtime reduces them.  Otherwise the
+// tool forces CILK_NWORKERS=1.
 #ifndef SERIAL_TOOL
 #define SERIAL_TOOL 1
 #endif
 
 #if !SERIAL_TOOL
+#include <cilk/cilk_api.h>
 #include <cilk/reducer.h>
 #include "context_stack_reducer.h"
 #endif
 
 #ifndef TRACE_CALLS
-#define TRACE_CALLS 1
+#define TRACE_CALLS 0
 #endif
 
 /*************************************************************************/
@@ -43,24 +54,24 @@ CILK_C_DECLARE_REDUCER(context_stack_t) ctx_stack =
 #endif
 
 bool TOOL_INITIALIZED = false;
+/* Set once cilk_tool_destroy has run, so that the hooks of the functions
+   that are still active do not set up the tool again. */
+bool TOOL_DESTROYED = false;
 
 /*************************************************************************/
 /**
  * Data structures and helper methods for time of user strands.
  */
 
-static inline uint64_t elapsed_nsec(const struct timespec *stop,
-			     const struct timespec *start) {
-  return (uint64_t)(stop->tv_sec - start->tv_sec) * 1000000000ll
-    + (stop->tv_nsec - start->tv_nsec);
+static inline uint64_t elapsed_ticks(const uint64_t *stop,
+                                     const uint64_t *start) {
+  return *stop - *start;
 }
 
-static inline void gettime(struct timespec *timer) {
-  // TB 2014-08-01: This is the "clock_gettime" variant I could get
-  // working with -std=c11.  I want to use TIME_MONOTONIC instead, but
-  // it does not appear to be supported on my system.
-  /* timespec_get(timer, TIME_UTC); */
-  clock_gettime(CLOCK_MONOTONIC, timer);
+static inline void gettime(uint64_t *timer) {
+  // Strands are timed in ticks of tsc_clock, which are converted to
+  // seconds only when the results are printed.
+  *timer = tsc_clock_now();
 }
 
 #if SERIAL_TOOL
@@ -79,11 +90,99 @@ static inline void ensure_serial_tool(void) {
 }
 #endif
 
+// Print the predicted speedup on P = 1, 2, ... workers of a computation
+// with work wrk and span spn, up to CILKVIEW_SPEEDUP_MAX_P workers or
+// the number of online processors.
+static void print_speedup(uint64_t wrk, uint64_t spn) {
+  int max_workers = speedup_max_workers("CILKVIEW_SPEEDUP_MAX_P");
+
+  fprintf(stderr, "workers, upper bound speedup, greedy lower bound speedup\n");
+  for (int P = 1; P <= max_workers; ++P) {
+    speedup_t s = predict_speedup(P, wrk, spn, spn);
+    fprintf(stderr, "%d, %f, %f\n", P, s.upper, s.greedy);
+  }
+}
+
+static int compare_site_parallelism(const void *a, const void *b) {
+  const site_t *x = (const site_t*)a, *y = (const site_t*)b;
+  double x_parallelism = x->wrk / (double)x->spn;
+  double y_parallelism = y->wrk / (double)y->spn;
+  return (x_parallelism > y_parallelism) - (x_parallelism < y_parallelism);
+}
+
+// Object file of the program that contains an address, and the address
+// relative to the load base of that object.
+typedef struct {
+  uintptr_t addr;
+  const char *path;
+  uintptr_t offset;
+} site_object_t;
+
+static int find_site_object(struct dl_phdr_info *info, size_t size, void *data) {
+  site_object_t *obj = (site_object_t*)data;
+  for (int i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr) *phdr = &(info->dlpi_phdr[i]);
+    uintptr_t low = info->dlpi_addr + phdr->p_vaddr;
+    if (PT_LOAD == phdr->p_type &&
+        low <= obj->addr && obj->addr < low + phdr->p_memsz) {
+      obj->path = info->dlpi_name;
+      obj->offset = obj->addr - info->dlpi_addr;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Print the call sites of Cilk functions in the table tab with the
+// lowest parallelism, up to CILKVIEW_SITES of them, 10 by default.
+// Each call site is printed as the object file that contains it and the
+// return address relative to the load base of that object, which
+// addr2line -e maps to a source line even when the object is
+// position-independent.
+static void print_sites(const site_table_t *tab) {
+  char *e = getenv("CILKVIEW_SITES");
+  int max_sites = (NULL != e) ? atoi(e) : 10;
+  if (max_sites <= 0 || 0 == tab->num_sites)
+    return;
+
+  site_t *sorted = (site_t*)malloc(sizeof(site_t) * tab->num_sites);
+  int num_sorted = 0;
+  for (size_t i = 0; i < ((size_t)1 << tab->lg_capacity); ++i) {
+    if (0 != tab->sites[i].rip && 0 != tab->sites[i].spn)
+      sorted[num_sorted++] = tab->sites[i];
+  }
+  qsort(sorted, num_sorted, sizeof(site_t), compare_site_parallelism);
+
+  char exe[4096];
+  ssize_t exe_len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+  if (exe_len < 0)
+    strcpy(exe, "/proc/self/exe");
+  else
+    exe[exe_len] = '\0';
+
+  fprintf(stderr, "object, call site, invocations, work, span, parallelism\n");
+  for (int i = 0; i < num_sorted && i < max_sites; ++i) {
+    site_object_t obj = { .addr = sorted[i].rip, .path = "?", .offset = sorted[i].rip };
+    dl_iterate_phdr(find_site_object, &obj);
+    // The main program has an empty name.
+    if ('\0' == obj.path[0])
+      obj.path = exe;
+    fprintf(stderr, "%s, 0x%" PRIxPTR ", %" PRIu64 ", %fs, %fs, %f\n",
+            obj.path, obj.offset, sorted[i].invocations,
+            tsc_clock_sec(sorted[i].wrk),
+            tsc_clock_sec(sorted[i].spn),
+            sorted[i].wrk / (double)sorted[i].spn);
+  }
+  free(sorted);
+}
+
 void cilk_tool_init(void) {
 #if TRACE_CALLS
   fprintf(stderr, "cilk_tool_init()\n");
 #endif
 
+  tsc_clock_init();
+
 #if SERIAL_TOOL
   ensure_serial_tool();
 
@@ -103,37 +202,56 @@ void cilk_tool_init(void) {
 #endif
 
   TOOL_INITIALIZED = true;
+  TOOL_DESTROYED = false;
 }
 
 void cilk_tool_destroy(void) {
 #if TRACE_CALLS
   fprintf(stderr, "cilk_tool_destroy()\n");
 #endif
-  /* CILK_C_UNREGISTER_REDUCER(ctx_stack); */
+  if (!TOOL_INITIALIZED)
+    return;
+
+  context_stack_t *stack;
+#if SERIAL_TOOL
+  stack = &(ctx_stack);
+#else
+  stack = &(REDUCER_VIEW(ctx_stack));
+#endif
+  // Free the frames left on the stack.  Hooks of the functions that
+  // are still active do nothing from here on.
+  context_stack_free(stack);
+#if !SERIAL_TOOL
+  CILK_C_UNREGISTER_REDUCER(ctx_stack);
+#endif
   TOOL_INITIALIZED = false;
+  TOOL_DESTROYED = true;
 }
 
 void cilk_tool_print(void) {
 
   assert(TOOL_INITIALIZED);
+  context_stack_t *stack;
 #if SERIAL_TOOL
-  assert(NULL != ctx_stack.bot);
-
-  uint64_t span = ctx_stack.bot->prefix_spn + ctx_stack.bot->contin_spn;
-  uint64_t work = ctx_stack.running_wrk;
+  stack = &(ctx_stack);
 #else
-  assert(MAIN == REDUCER_VIEW(ctx_stack).bot->func_type);
-  assert(NULL != REDUCER_VIEW(ctx_stack).bot);
-
-  uint64_t span = REDUCER_VIEW(ctx_stack).bot->prefix_spn + REDUCER_VIEW(ctx_stack).bot->contin_spn;
-  uint64_t work = REDUCER_VIEW(ctx_stack).running_wrk;
+  stack = &(REDUCER_VIEW(ctx_stack));
+  assert(MAIN == stack->bot->func_type);
 #endif
+  assert(NULL != stack->bot);
+
+  uint64_t span = stack->bot->prefix_spn + stack->bot->contin_spn;
+  uint64_t work = stack->running_wrk;
 
   fprintf(stderr, "work = %fs, span = %fs, parallelism = %f\n",
-	  work / (1000000000.0),
-	  span / (1000000000.0),
+	  tsc_clock_sec(work),
+	  tsc_clock_sec(span),
 	  work / (float)span);
-
+#if !SERIAL_TOOL
+  fprintf(stderr, "measured on %d workers\n", __cilkrts_get_nworkers());
+#endif
+  print_speedup(work, span);
+  print_sites(&(stack->sites));
 }
 
 
@@ -142,16 +260,20 @@ void cilk_tool_print(void) {
  * Hooks into runtime system.
  */
 
-void cilk_enter_begin(__cilkrts_stack_frame *sf, void *this_fn, void *rip)
+void cilk_enter_begin(uint32_t prop, __cilkrts_stack_frame *sf, void *this_fn, void *rip)
 {
   context_stack_t *stack;
 #if TRACE_CALLS
-  fprintf(stderr, "cilk_enter_begin(%p, %p, %p)\n", sf, this_fn, rip);
+  fprintf(stderr, "cilk_enter_begin(%u, %p, %p, %p)\n", prop, sf, this_fn, rip);
 #endif
   /* fprintf(stderr, "worker %d entering %p\n", __cilkrts_get_worker_number(), sf); */
 
+  if (TOOL_DESTROYED)
+    return;
+
   if (!TOOL_INITIALIZED) {
     /* cilk_tool_init(); */
+    tsc_clock_init();
 #if SERIAL_TOOL
     ensure_serial_tool();
     context_stack_init(&(ctx_stack), MAIN);
@@ -191,7 +313,7 @@ void cilk_enter_begin(__cilkrts_stack_frame *sf, void *this_fn, void *rip)
       // shrink-wrapping has taken place.
       /* assert(stack->in_user_code); */
       
-      uint64_t strand_time = elapsed_nsec(&(stack->stop), &(stack->start));
+      uint64_t strand_time = elapsed_ticks(&(stack->stop), &(stack->start));
       stack->running_wrk += strand_time;
       stack->bot->contin_spn += strand_time;
       
@@ -202,11 +324,20 @@ void cilk_enter_begin(__cilkrts_stack_frame *sf, void *this_fn, void *rip)
   }
 
   /* Push new frame onto the stack */
-  context_stack_push(stack, SPAWN);
+  context_stack_frame_t *frame = context_stack_push(stack, SPAWN);
+  frame->rip = (uintptr_t)__builtin_extract_return_addr(rip);
+  frame->entry_wrk = stack->running_wrk;
+
+  site_t *site = site_table_get(&(stack->sites), frame->rip);
+  ++site->active;
+  ++site->invocations;
 }
 
 void cilk_enter_helper_begin(__cilkrts_stack_frame *sf, void *this_fn, void *rip)
 {
+  if (!TOOL_INITIALIZED)
+    return;
+
   context_stack_t *stack;
 #if SERIAL_TOOL
   stack = &(ctx_stack);
@@ -228,6 +359,9 @@ void cilk_enter_helper_begin(__cilkrts_stack_frame *sf, void *this_fn, void *rip
 
 void cilk_enter_end(__cilkrts_stack_frame *sf, void *rsp)
 {
+  if (!TOOL_INITIALIZED)
+    return;
+
   context_stack_t *stack;
 #if SERIAL_TOOL
   stack = &(ctx_stack);
@@ -247,19 +381,20 @@ void cilk_enter_end(__cilkrts_stack_frame *sf, void *rsp)
     fprintf(stderr, "cilk_enter_end(%p, %p) from SPAWN\n", sf, rsp);
 #endif
     assert(!(stack->in_user_code));
+    stack->in_user_code = true;
+    gettime(&(stack->start));
   } else {
 #if TRACE_CALLS
     fprintf(stderr, "cilk_enter_end(%p, %p) from HELPER\n", sf, rsp);
 #endif
+    /* A spawn helper runs no user code before it detaches and calls
+       the spawned function. */
   }
-
-  stack->in_user_code = true;
-  gettime(&(stack->start));
 }
 
-void cilk_tool_c_function_enter(void *this_fn, void *rip) {
+void cilk_tool_c_function_enter(uint32_t prop, void *this_fn, void *rip) {
 #if TRACE_CALLS
-  fprintf(stderr, "c_function_enter(%p, %p)\n", this_fn, rip);
+  fprintf(stderr, "c_function_enter(%u, %p, %p)\n", prop, this_fn, rip);
 #endif
 }
 
@@ -284,7 +419,7 @@ void cilk_spawn_prepare(__cilkrts_stack_frame *sf)
 
     gettime(&(stack->stop));
 
-    uint64_t strand_time = elapsed_nsec(&(stack->stop), &(stack->start));
+    uint64_t strand_time = elapsed_ticks(&(stack->stop), &(stack->start));
     stack->running_wrk += strand_time;
     stack->bot->contin_spn += strand_time;
 
@@ -295,6 +430,9 @@ void cilk_spawn_prepare(__cilkrts_stack_frame *sf)
 
 void cilk_spawn_or_continue(int in_continuation)
 {
+  if (!TOOL_INITIALIZED)
+    return;
+
   if (in_continuation) {
     // In the continuation
 #if TRACE_CALLS
@@ -336,6 +474,9 @@ void cilk_detach_end(void)
 
 void cilk_sync_begin(__cilkrts_stack_frame *sf)
 {
+  if (!TOOL_INITIALIZED)
+    return;
+
   context_stack_t *stack;
 #if SERIAL_TOOL
   stack = &(ctx_stack);
@@ -346,7 +487,7 @@ void cilk_sync_begin(__cilkrts_stack_frame *sf)
 
   if (SPAWN == stack->bot->func_type) {
 
-    uint64_t strand_time = elapsed_nsec(&(stack->stop), &(stack->start));
+    uint64_t strand_time = elapsed_ticks(&(stack->stop), &(stack->start));
     stack->running_wrk += strand_time;
     stack->bot->contin_spn += strand_time;
 #if TRACE_CALLS
@@ -363,6 +504,9 @@ void cilk_sync_begin(__cilkrts_stack_frame *sf)
 
 void cilk_sync_end(__cilkrts_stack_frame *sf)
 {
+  if (!TOOL_INITIALIZED)
+    return;
+
   context_stack_t *stack;
 #if SERIAL_TOOL
   stack = &(ctx_stack);
@@ -394,6 +538,9 @@ void cilk_sync_end(__cilkrts_stack_frame *sf)
 
 void cilk_leave_begin(__cilkrts_stack_frame *sf)
 {
+  if (!TOOL_INITIALIZED)
+    return;
+
   context_stack_t *stack;
 #if SERIAL_TOOL
   stack = &(ctx_stack);
@@ -412,7 +559,7 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
 #if TRACE_CALLS
     fprintf(stderr, "cilk_leave_begin(%p) from SPAWN\n", sf);
 #endif
-    uint64_t strand_time = elapsed_nsec(&(stack->stop), &(stack->start));
+    uint64_t strand_time = elapsed_ticks(&(stack->stop), &(stack->start));
     stack->running_wrk += strand_time;
     stack->bot->contin_spn += strand_time;
     assert(NULL != stack->bot->parent);
@@ -420,6 +567,17 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
     assert(0 == stack->bot->lchild_spn);
     stack->bot->prefix_spn += stack->bot->contin_spn;
 
+    /* Charge the work and span of the function to its call site,
+       unless it is nested inside another call from the same site.  In
+       a parallel run, a view created for a stolen continuation does
+       not see the calls active in its parent's view, so recursive calls
+       made from it may be charged as well. */
+    site_t *site = site_table_get(&(stack->sites), stack->bot->rip);
+    if (0 == --site->active) {
+      site->wrk += stack->running_wrk - stack->bot->entry_wrk;
+      site->spn += stack->bot->prefix_spn;
+    }
+
     /* Pop the stack */
     old_bottom = context_stack_pop(stack);
     stack->bot->contin_spn += old_bottom->prefix_spn;
@@ -445,11 +603,14 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
     
   }
 
-  free(old_bottom);
+  context_stack_frame_free(stack, old_bottom);
 }
 
 void cilk_leave_end(void)
 {
+  if (!TOOL_INITIALIZED)
+    return;
+
   context_stack_t *stack;
 #if SERIAL_TOOL
   stack = &(ctx_stack);
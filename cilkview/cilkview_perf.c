@@ -6,9 +6,12 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <assert.h>
 
 #include <locale.h>
+#include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <err.h>
 
 #include <cilk/cilk.h>
@@ -21,6 +24,7 @@
 #include <cilk/reducer.h>
 
 #include "cilkview_perf_stack.h"
+#include "tsc_clock.h"
 
 /*************************************************************************/
 /**
@@ -30,86 +34,247 @@
 cilkview_perf_stack_t ctx_stack;
 
 bool TOOL_INITIALIZED = false;
-const char *perf_event = "instructions";
-struct perf_event_attr attr;
+
+/* Events counted if CILKVIEW_PERF_EVENTS does not name a group of
+   events, separated by commas, such as
+   "cycles,instructions,cache-misses,branch-misses". */
+const char *DEFAULT_PERF_EVENTS = "instructions";
+
+/* Group of events counted for every strand.  The events are opened as
+   one perf_event group, so that the kernel schedules them onto the
+   counters together, and they are read from user space with rdpmc
+   through the page of each event that the kernel maps, unless the
+   kernel does not allow rdpmc, in which case the group is read with a
+   single read() of the group leader. */
+typedef struct {
+  int num_events;
+  char *names[MAX_PERF_EVENTS];
+  int fd[MAX_PERF_EVENTS];
+  struct perf_event_mmap_page *page[MAX_PERF_EVENTS];
+  bool use_rdpmc;
+
+  /* Times the group was enabled and running when counting began and
+     ended.  If the kernel multiplexes the counters among more events
+     than they can hold, the group runs for only part of the time it is
+     enabled, and its counts are scaled by their ratio. */
+  uint64_t enabled_start, running_start;
+  uint64_t enabled_stop, running_stop;
+} perf_group_t;
+
+perf_group_t perf_group;
+
+/* Number of metrics in which strands are measured: time and one per
+   event */
+int num_metrics = 1;
 
 /*************************************************************************/
 /**
  * Data structures and helper methods for time of user strands.
  */
 
-static inline uint64_t elapsed_nsec(const struct timespec *stop,
-				    const struct timespec *start) {
-  return (uint64_t)(stop->tv_sec - start->tv_sec) * 1000000000ll
-    + (stop->tv_nsec - start->tv_nsec);
+static inline void gettime(uint64_t *timer) {
+  // Strands are timed in ticks of tsc_clock, which are converted to
+  // seconds only when the results are printed.
+  *timer = tsc_clock_now();
+}
+
+/* Returns the value of performance-monitoring counter counter. */
+static inline __attribute__((always_inline)) uint64_t rdpmc(uint32_t counter) {
+#if defined(__x86_64__) || defined(__i386__)
+  uint32_t lo, hi;
+  __asm__ __volatile__ ("rdpmc" : "=a"(lo), "=d"(hi) : "c"(counter));
+  return (uint64_t)lo + (((uint64_t)hi) << 32);
+#else
+  return 0;
+#endif
+}
+
+/* Returns the count of the event whose page the kernel mapped at
+   *page, following the protocol described in linux/perf_event.h. */
+static inline __attribute__((always_inline))
+uint64_t perf_page_count(volatile struct perf_event_mmap_page *page) {
+  uint32_t seq, idx;
+  uint64_t count;
+  do {
+    seq = page->lock;
+    __asm__ __volatile__ ("" ::: "memory");
+    idx = page->index;
+    count = page->offset;
+    /* An index of 0 means that the event is not on a counter right
+       now, in which case offset holds its count. */
+    if (idx) {
+      uint16_t width = page->pmc_width;
+      int64_t pmc = rdpmc(idx - 1);
+      pmc <<= 64 - width;
+      pmc >>= 64 - width;
+      count += pmc;
+    }
+    __asm__ __volatile__ ("" ::: "memory");
+  } while (page->lock != seq);
+  return count;
+}
+
+/* Reads the group with a system call, storing the count of each event
+   in counts and, if they are not NULL, the times the group has been
+   enabled and running in *enabled and *running. */
+static void perf_read_group(uint64_t *counts, uint64_t *enabled, uint64_t *running) {
+  /* Layout of PERF_FORMAT_GROUP with the enabled and running times */
+  uint64_t values[3 + MAX_PERF_EVENTS];
+  size_t size = (3 + perf_group.num_events) * sizeof(uint64_t);
+  if (read(perf_group.fd[0], values, size) != (ssize_t)size) {
+    err(1, "cannot read results: %s", strerror(errno));
+  }
+  assert(values[0] == (uint64_t)perf_group.num_events);
+  if (enabled)
+    *enabled = values[1];
+  if (running)
+    *running = values[2];
+  for (int i = 0; i < perf_group.num_events; ++i)
+    counts[i] = values[3 + i];
+}
+
+/* Stores the count of each event in counts. */
+static inline void perf_get_counts(uint64_t *counts) {
+  if (__builtin_expect(perf_group.use_rdpmc, true)) {
+    for (int i = 0; i < perf_group.num_events; ++i)
+      counts[i] = perf_page_count(perf_group.page[i]);
+  } else {
+    perf_read_group(counts, NULL, NULL);
+  }
 }
 
-static inline void gettime(struct timespec *timer) {
-  // TB 2014-08-01: This is the "clock_gettime" variant I could get
-  // working with -std=c11.  I want to use TIME_MONOTONIC instead, but
-  // it does not appear to be supported on my system.
-  timespec_get(timer, TIME_UTC);
+/* Records the times the group has been enabled and running in
+   *enabled and *running. */
+static void perf_get_times(uint64_t *enabled, uint64_t *running) {
+  uint64_t counts[MAX_PERF_EVENTS];
+  perf_read_group(counts, enabled, running);
 }
 
-static inline int perf_setup(void) {
+static void perf_setup(void) {
   int ret;
   ret = pfm_initialize();
   if (PFM_SUCCESS != ret) {
     errx(1, "cannot initialize library: %s", pfm_strerror(ret));
   }
 
-  memset(&attr, 0, sizeof(attr));
+  const char *events = getenv("CILKVIEW_PERF_EVENTS");
+  if (NULL == events || '\0' == events[0])
+    events = DEFAULT_PERF_EVENTS;
+
+  long page_size = sysconf(_SC_PAGESIZE);
+  perf_group.num_events = 0;
+  perf_group.use_rdpmc = true;
+
+  char *events_copy = strdup(events);
+  char *saveptr;
+  for (char *name = strtok_r(events_copy, ",", &saveptr); NULL != name;
+       name = strtok_r(NULL, ",", &saveptr)) {
+    int i = perf_group.num_events;
+    if (MAX_PERF_EVENTS == i) {
+      errx(1, "cannot count more than %d events", MAX_PERF_EVENTS);
+    }
 
-  ret = pfm_get_perf_event_encoding(perf_event, PFM_PLM0 | PFM_PLM3, &attr, NULL, NULL);
-  if (PFM_SUCCESS != ret) {
-    errx(1, "cannot find encoding: %s", pfm_strerror(ret));
-  }
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    ret = pfm_get_perf_event_encoding(name, PFM_PLM0 | PFM_PLM3, &attr, NULL, NULL);
+    if (PFM_SUCCESS != ret) {
+      errx(1, "cannot find encoding of %s: %s", name, pfm_strerror(ret));
+    }
 
-  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
-  attr.disabled = 1;
+    attr.read_format = PERF_FORMAT_GROUP |
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    /* The group is enabled through its leader. */
+    attr.disabled = (0 == i);
 
-  int fd;
-  fd = perf_event_open(&attr, getpid(), -1, -1, 0);
-  if (fd < 0) {
-    err(1, "cannot create event");
+    int fd = perf_event_open(&attr, getpid(), -1,
+                             (0 == i) ? -1 : perf_group.fd[0], 0);
+    if (fd < 0) {
+      err(1, "cannot create event %s", name);
+    }
+    perf_group.fd[i] = fd;
+    perf_group.names[i] = strdup(name);
+
+    void *page = mmap(NULL, page_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == page) {
+      perf_group.page[i] = NULL;
+      perf_group.use_rdpmc = false;
+    } else {
+      perf_group.page[i] = (struct perf_event_mmap_page *)page;
+    }
+    ++perf_group.num_events;
   }
+  free(events_copy);
 
-  ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  if (0 == perf_group.num_events) {
+    errx(1, "no events in CILKVIEW_PERF_EVENTS");
+  }
+  num_metrics = 1 + perf_group.num_events;
 
-  return fd;
-}
+  ioctl(perf_group.fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
 
-static inline void perf_shutdown(int fd) {
-  ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  for (int i = 0; i < perf_group.num_events && perf_group.use_rdpmc; ++i) {
+    perf_group.use_rdpmc = perf_group.page[i]->cap_user_rdpmc;
+  }
+  if (!perf_group.use_rdpmc) {
+    fprintf(stderr, "rdpmc is not available, reading counters with read().\n");
+  }
 
-  pfm_terminate();
+  perf_get_times(&perf_group.enabled_start, &perf_group.running_start);
+  perf_group.enabled_stop = perf_group.enabled_start;
+  perf_group.running_stop = perf_group.running_start;
 }
 
-static inline void perf_get_count(int fd, uint64_t* values /* uint64_t[3] */) {
-  int ret;
-  ret = read(fd, values, 3 * sizeof(uint64_t));
-  if (ret != 3 * sizeof(uint64_t)) {
-    err(1, "cannot read results: %s", strerror(errno));
+static void perf_shutdown(void) {
+  if (0 == perf_group.num_events)
+    return;
+
+  perf_get_times(&perf_group.enabled_stop, &perf_group.running_stop);
+  ioctl(perf_group.fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  long page_size = sysconf(_SC_PAGESIZE);
+  for (int i = perf_group.num_events - 1; i >= 0; --i) {
+    if (NULL != perf_group.page[i])
+      munmap(perf_group.page[i], page_size);
+    close(perf_group.fd[i]);
+    free(perf_group.names[i]);
   }
-}
+  perf_group.num_events = 0;
 
-static inline uint64_t
-elapsed_perf_count(const uint64_t *stop_values /* uint64_t[3] */,
-		   const uint64_t *start_values /* uint64_t[3] */) {
-  return (uint64_t)((double)((stop_values[0] - start_values[0])
-			     * (stop_values[1] - start_values[1])
-			     / (stop_values[2] - start_values[2])));
+  pfm_terminate();
 }
 
+/* Returns the factor by which event counts are scaled to make up for
+   the time the group was enabled but not running.  Strands are much
+   shorter than the intervals at which the kernel rotates multiplexed
+   events, so the counts of single strands cannot be scaled by their
+   own running times; instead all counts are scaled by the fraction of
+   the whole run during which the group was counting. */
+static double perf_scale(void) {
+  uint64_t enabled = perf_group.enabled_stop - perf_group.enabled_start;
+  uint64_t running = perf_group.running_stop - perf_group.running_start;
+  if (0 == running)
+    return 0.0;
+  return (double)enabled / (double)running;
+}
 
 static inline void start_strand(cilkview_perf_stack_t *stack) {
-  perf_get_count(stack->fd, stack->start_values);
-  gettime(&(stack->start));
+  perf_get_counts(&(stack->start[1]));
+  gettime(&(stack->start[0]));
 }
 
 static inline void stop_strand(cilkview_perf_stack_t *stack) {
-  gettime(&(stack->stop));
-  perf_get_count(stack->fd, stack->stop_values);
+  gettime(&(stack->stop[0]));
+  perf_get_counts(&(stack->stop[1]));
+}
+
+/* Adds the length of the strand that just stopped, in each metric, to
+   the work and to the span of the continuation of the bottom frame. */
+static inline void add_strand(cilkview_perf_stack_t *stack) {
+  for (int m = 0; m < num_metrics; ++m) {
+    uint64_t strand_len = stack->stop[m] - stack->start[m];
+    stack->running_wrk[m] += strand_len;
+    stack->bot->contin_spn[m] += strand_len;
+  }
 }
 
 /*************************************************************************/
@@ -120,19 +285,21 @@ void cilk_tool_init(void) {
 
   assert(1 == __cilkrts_get_nworkers());
 
+  tsc_clock_init();
+
   setlocale(LC_ALL, "");
 
   cilkview_perf_stack_init(&ctx_stack, MAIN);
   ctx_stack.in_user_code = true;
 
-  ctx_stack.fd = perf_setup();
+  perf_setup();
   
   start_strand(&ctx_stack);
 }
 
 void cilk_tool_destroy(void) {
 
-  perf_shutdown(ctx_stack.fd);
+  perf_shutdown();
 
   TOOL_INITIALIZED = false;
 }
@@ -143,24 +310,42 @@ void cilk_tool_print(void) {
 
   assert(NULL != ctx_stack.bot);
 
-  ctx_stack.bot->prefix_spn += ctx_stack.bot->contin_spn;
-  ctx_stack.bot->prefix_spn_data += ctx_stack.bot->contin_spn_data;
+  for (int m = 0; m < num_metrics; ++m) {
+    ctx_stack.bot->prefix_spn[m] += ctx_stack.bot->contin_spn[m];
+    ctx_stack.bot->contin_spn[m] = 0;
+  }
 
-  uint64_t span = ctx_stack.bot->prefix_spn;
-  uint64_t work = ctx_stack.running_wrk;
+  uint64_t span = ctx_stack.bot->prefix_spn[0];
+  uint64_t work = ctx_stack.running_wrk[0];
 
   fprintf(stderr, "work = %fs, span = %fs, parallelism = %f\n",
-	  work / (1000000000.0),
-	  span / (1000000000.0),
+	  tsc_clock_sec(work),
+	  tsc_clock_sec(span),
 	  (double)work / (double)span);
 
-  uint64_t span_data = ctx_stack.bot->prefix_spn_data;
-  uint64_t work_data = ctx_stack.running_wrk_data;
-  fprintf(stderr, "work_data = %lu, span_data = %lu, parallelism = %f\n",
-	  work_data,
-	  span_data,
-	  (double)work_data / (double)span_data);
+  if (0 == perf_group.num_events)
+    return;
+
+  perf_get_times(&perf_group.enabled_stop, &perf_group.running_stop);
+  double scale = perf_scale();
+  if (0.0 == scale) {
+    fprintf(stderr, "events were never counted; the group may need more counters than there are\n");
+    return;
+  }
 
+  for (int i = 0; i < perf_group.num_events; ++i) {
+    double work_data = scale * ctx_stack.running_wrk[1 + i];
+    double span_data = scale * ctx_stack.bot->prefix_spn[1 + i];
+    fprintf(stderr, "%s: work = %.0f, span = %.0f, parallelism = %f\n",
+	    perf_group.names[i],
+	    work_data,
+	    span_data,
+	    work_data / span_data);
+  }
+  if (scale > 1.0) {
+    fprintf(stderr, "events were counted %.1f%% of the time; counts are scaled by %f\n",
+	    100.0 / scale, scale);
+  }
 }
 
 
@@ -169,7 +354,7 @@ void cilk_tool_print(void) {
  * Hooks into runtime system.
  */
 
-void cilk_enter_begin(__cilkrts_stack_frame *sf, void *this_fn, void *rip)
+void cilk_enter_begin(uint32_t prop, __cilkrts_stack_frame *sf, void *this_fn, void *rip)
 {
   cilkview_perf_stack_t *stack;
   /* fprintf(stderr, "cilk_enter_begin(%p, %p, %p)\n", sf, this_fn, rip); */
@@ -180,9 +365,10 @@ void cilk_enter_begin(__cilkrts_stack_frame *sf, void *this_fn, void *rip)
 
     stack = &ctx_stack;
 
+    tsc_clock_init();
     cilkview_perf_stack_init(stack, MAIN);
 
-    stack->fd = perf_setup();
+    perf_setup();
     
     TOOL_INITIALIZED = true;
 
@@ -197,14 +383,7 @@ void cilk_enter_begin(__cilkrts_stack_frame *sf, void *this_fn, void *rip)
     if (stack->bot->func_type != HELPER) {
       assert(stack->in_user_code);
       
-      uint64_t strand_time = elapsed_nsec(&(stack->stop), &(stack->start));
-      stack->running_wrk += strand_time;
-      stack->bot->contin_spn += strand_time;
-      
-      /* Get performance data from perf counter. */
-      strand_time = elapsed_perf_count(stack->stop_values, stack->start_values);
-      stack->running_wrk_data += strand_time;
-      stack->bot->contin_spn_data += strand_time;
+      add_strand(stack);
 
       stack->in_user_code = false;
     } else {
@@ -247,7 +426,7 @@ void cilk_enter_end(__cilkrts_stack_frame *sf, void *rsp)
   }
 }
 
-void cilk_tool_c_function_enter(void *this_fn, void *rip) {
+void cilk_tool_c_function_enter(uint32_t prop, void *this_fn, void *rip) {
   /* fprintf(stderr, "C function enter %p.\n", rip); */
 }
 
@@ -264,14 +443,7 @@ void cilk_spawn_prepare(__cilkrts_stack_frame *sf)
 
   // fprintf(stderr, "cilk_spawn_prepare()\n");
 
-  uint64_t strand_time = elapsed_nsec(&(stack->stop), &(stack->start));
-  stack->running_wrk += strand_time;
-  stack->bot->contin_spn += strand_time;
-
-  /* Get performance data from perf counter. */
-  strand_time = elapsed_perf_count(stack->stop_values, stack->start_values);
-  stack->running_wrk_data += strand_time;
-  stack->bot->contin_spn_data += strand_time;
+  add_strand(stack);
 
   assert(stack->in_user_code);
   stack->in_user_code = false;
@@ -317,14 +489,7 @@ void cilk_sync_begin(__cilkrts_stack_frame *sf)
 
   if (SPAWN == stack->bot->func_type) {
 
-    uint64_t strand_time = elapsed_nsec(&(stack->stop), &(stack->start));
-    stack->running_wrk += strand_time;
-    stack->bot->contin_spn += strand_time;
-
-    /* Get performance data from perf counter. */
-    strand_time = elapsed_perf_count(stack->stop_values, stack->start_values);
-    stack->running_wrk_data += strand_time;
-    stack->bot->contin_spn_data += strand_time;
+    add_strand(stack);
 
     // fprintf(stderr, "cilk_sync_begin() from SPAWN\n");
     assert(stack->in_user_code);
@@ -339,18 +504,15 @@ void cilk_sync_end(__cilkrts_stack_frame *sf)
   /* cilkview_perf_stack_t *stack = &(REDUCER_VIEW(ctx_stack)); */
   cilkview_perf_stack_t *stack = &ctx_stack;
 
-  /* if (stack->bot->lchild_spn > stack->bot->contin_spn) { */
-  if (stack->bot->lchild_spn_data > stack->bot->contin_spn_data) {
-    stack->bot->prefix_spn += stack->bot->lchild_spn;
-    stack->bot->prefix_spn_data += stack->bot->lchild_spn_data;
-  } else {
-    stack->bot->prefix_spn += stack->bot->contin_spn;
-    stack->bot->prefix_spn_data += stack->bot->contin_spn_data;
+  for (int m = 0; m < num_metrics; ++m) {
+    if (stack->bot->lchild_spn[m] > stack->bot->contin_spn[m]) {
+      stack->bot->prefix_spn[m] += stack->bot->lchild_spn[m];
+    } else {
+      stack->bot->prefix_spn[m] += stack->bot->contin_spn[m];
+    }
+    stack->bot->lchild_spn[m] = 0;
+    stack->bot->contin_spn[m] = 0;
   }
-  stack->bot->lchild_spn = 0;
-  stack->bot->contin_spn = 0;
-  stack->bot->lchild_spn_data = 0;
-  stack->bot->contin_spn_data = 0;
   
   if (SPAWN == stack->bot->func_type) {
     assert(!(stack->in_user_code));
@@ -377,53 +539,42 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
   if (SPAWN == stack->bot->func_type) {
     /* fprintf(stderr, "cilk_leave_begin(%p) from SPAWN\n", sf); */
 
-    uint64_t strand_time = elapsed_nsec(&(stack->stop), &(stack->start));
-    stack->running_wrk += strand_time;
-    stack->bot->contin_spn += strand_time;
-
-    /* Get performance data from perf counter. */
-    strand_time = elapsed_perf_count(stack->start_values, stack->stop_values);
-    stack->running_wrk_data += strand_time;
-    stack->bot->contin_spn_data += strand_time;
+    add_strand(stack);
 
     assert(stack->in_user_code);
     stack->in_user_code = false;
 
     assert(NULL != stack->bot->parent);
 
-    assert(0 == stack->bot->lchild_spn);
-    stack->bot->prefix_spn += stack->bot->contin_spn;
-    stack->bot->prefix_spn_data += stack->bot->contin_spn_data;
+    assert(0 == stack->bot->lchild_spn[0]);
+    for (int m = 0; m < num_metrics; ++m)
+      stack->bot->prefix_spn[m] += stack->bot->contin_spn[m];
 
     /* Pop the stack */
     old_bottom = cilkview_perf_stack_pop(stack);
-    stack->bot->contin_spn += old_bottom->prefix_spn;
-    stack->bot->contin_spn_data += old_bottom->prefix_spn_data;
+    for (int m = 0; m < num_metrics; ++m)
+      stack->bot->contin_spn[m] += old_bottom->prefix_spn[m];
     
   } else {
     /* fprintf(stderr, "cilk_leave_begin(%p) from HELPER\n", sf); */
 
     assert(HELPER != stack->bot->parent->func_type);
 
-    assert(0 == stack->bot->lchild_spn);
-    stack->bot->prefix_spn += stack->bot->contin_spn;
-    stack->bot->prefix_spn_data += stack->bot->contin_spn_data;
+    assert(0 == stack->bot->lchild_spn[0]);
+    for (int m = 0; m < num_metrics; ++m)
+      stack->bot->prefix_spn[m] += stack->bot->contin_spn[m];
 
     /* Pop the stack */
     old_bottom = cilkview_perf_stack_pop(stack);
-    /* if (stack->bot->contin_spn + old_bottom->prefix_spn > stack->bot->lchild_spn) { */
-    if (stack->bot->contin_spn_data + old_bottom->prefix_spn_data
-	> stack->bot->lchild_spn_data) {
-
-      // fprintf(stderr, "updating longest child\n");
-      stack->bot->prefix_spn += stack->bot->contin_spn;
-      stack->bot->prefix_spn_data += stack->bot->contin_spn_data;
-
-      stack->bot->lchild_spn = old_bottom->prefix_spn;
-      stack->bot->lchild_spn_data = old_bottom->prefix_spn_data;
-
-      stack->bot->contin_spn = 0;
-      stack->bot->contin_spn_data = 0;
+    for (int m = 0; m < num_metrics; ++m) {
+      if (stack->bot->contin_spn[m] + old_bottom->prefix_spn[m]
+	  > stack->bot->lchild_spn[m]) {
+
+	// fprintf(stderr, "updating longest child\n");
+	stack->bot->prefix_spn[m] += stack->bot->contin_spn[m];
+	stack->bot->lchild_spn[m] = old_bottom->prefix_spn[m];
+	stack->bot->contin_spn[m] = 0;
+      }
     }
     
   }
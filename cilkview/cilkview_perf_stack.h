@@ -2,9 +2,18 @@
 #define INCLUDED_CILKVIEW_PERF_STACK_H
 
 #include <stdbool.h>
+#include <string.h>
 #include <time.h>
 #define _POSIX_C_SOURCE = 200112L
 
+/* Maximum number of hardware events counted in a group */
+#define MAX_PERF_EVENTS 8
+
+/* Strands are measured in several metrics: metric 0 is time, in ticks
+   of tsc_clock, and metric i > 0 is the count of the (i-1)st event of
+   the group. */
+#define MAX_METRICS (1 + MAX_PERF_EVENTS)
+
 /* Enum for types of functions */
 typedef enum {
   MAIN,
@@ -26,22 +35,17 @@ typedef struct cilkview_perf_stack_frame_t {
   /* Pointer to the frame's parent */
   struct cilkview_perf_stack_frame_t *parent;
 
-  /* Span of the prefix of this function */
-  uint64_t prefix_spn;
-  /* Perf count associated with the function's prefix */
-  uint64_t prefix_spn_data;
+  /* Span of the prefix of this function, in each metric */
+  uint64_t prefix_spn[MAX_METRICS];
 
   /* Span of the longest spawned child of this function observed so
-     far */
-  uint64_t lchild_spn;
-  /* Perf count associated with the function's longest child */
-  uint64_t lchild_spn_data;
+     far, in each metric.  The longest child is chosen separately for
+     each metric. */
+  uint64_t lchild_spn[MAX_METRICS];
 
   /* Span of the continuation of the function since the spawn of its
-     longest child */
-  uint64_t contin_spn;
-  /* Perf count associated with the function's continuation */
-  uint64_t contin_spn_data;
+     longest child, in each metric */
+  uint64_t contin_spn[MAX_METRICS];
 
 } cilkview_perf_stack_frame_t;
 
@@ -51,23 +55,16 @@ typedef struct {
      is mostly used for debugging. */
   bool in_user_code;
 
-  int fd;
-  uint64_t start_values[3];
-  uint64_t stop_values[3];
-
-  /* Start and stop timers for measuring the execution time of a
-     strand. */
-  struct timespec start;
-  struct timespec stop;
+  /* Time and event counts at the start and stop of a strand, indexed
+     by metric */
+  uint64_t start[MAX_METRICS];
+  uint64_t stop[MAX_METRICS];
 
   /* Pointer to bottom of the stack, onto which frames are pushed. */
   cilkview_perf_stack_frame_t *bot;
 
-  /* Running total of work. */
-  uint64_t running_wrk;
-
-  /* Perf count associated with the running work */
-  uint64_t running_wrk_data;
+  /* Running total of work, in each metric. */
+  uint64_t running_wrk[MAX_METRICS];
 
 } cilkview_perf_stack_t;
 
@@ -81,17 +78,9 @@ void cilkview_perf_stack_frame_init(cilkview_perf_stack_frame_t *frame,
   frame->rip = __builtin_extract_return_addr(__builtin_return_address(0));
   frame->height = 0;
 
-  frame->prefix_spn = 0;
-  /* frame->prefix_spn_data = NULL; */
-  frame->prefix_spn_data = 0;
-
-  frame->lchild_spn = 0;
-  /* frame->lchild_spn_data = NULL; */
-  frame->lchild_spn_data = 0;
-
-  frame->contin_spn = 0;
-  /* frame->contin_spn_data = NULL; */
-  frame->contin_spn_data = 0;
+  memset(frame->prefix_spn, 0, sizeof(frame->prefix_spn));
+  memset(frame->lchild_spn, 0, sizeof(frame->lchild_spn));
+  memset(frame->contin_spn, 0, sizeof(frame->contin_spn));
 }
 
 /* Initializes the context stack */
@@ -102,9 +91,7 @@ void cilkview_perf_stack_init(cilkview_perf_stack_t *stack,
     (cilkview_perf_stack_frame_t *)malloc(sizeof(cilkview_perf_stack_frame_t));
   cilkview_perf_stack_frame_init(new_frame, func_type);
   stack->bot = new_frame;
-  stack->running_wrk = 0;
-  /* stack->running_wrk_data = NULL; */
-  stack->running_wrk_data = 0;
+  memset(stack->running_wrk, 0, sizeof(stack->running_wrk));
   stack->in_user_code = false;
 }
 
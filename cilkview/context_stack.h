@@ -5,6 +5,8 @@
 #include <time.h>
 /* #define _POSIX_C_SOURCE 200112L */
 
+#include "site_table.h"
+
 /* Enum for types of functions */
 typedef enum {
   MAIN,
@@ -20,28 +22,26 @@ typedef struct context_stack_frame_t {
   /* Height of the function */
   int32_t height;
 
-  /* Return address of this function */
-  void* rip;
+  /* Return address of the call to this function, which identifies its
+     call site */
+  uintptr_t rip;
 
   /* Pointer to the frame's parent */
   struct context_stack_frame_t *parent;
 
+  /* Running work of the stack when this function was entered */
+  uint64_t entry_wrk;
+
   /* Span of the prefix of this function */
   uint64_t prefix_spn;
-  /* Data associated with the function's prefix */
-  void* prefix_data;
 
   /* Span of the longest spawned child of this function observed so
      far */
   uint64_t lchild_spn;
-  /* Data associated with the function's longest child */
-  void* lchild_data;
 
   /* Span of the continuation of the function since the spawn of its
      longest child */
   uint64_t contin_spn;
-  /* Data associated with the function's continuation */
-  void* contin_data;
 
 } context_stack_frame_t;
 
@@ -50,15 +50,13 @@ void context_stack_frame_init(context_stack_frame_t *frame, cilk_function_type f
 {
   frame->parent = NULL;
   frame->func_type = func_type;
-  frame->rip = __builtin_extract_return_addr(__builtin_return_address(0));
+  frame->rip = 0;
   frame->height = 0;
 
+  frame->entry_wrk = 0;
   frame->prefix_spn = 0;
-  frame->prefix_data = NULL;
   frame->lchild_spn = 0;
-  frame->lchild_data = NULL;
   frame->contin_spn = 0;
-  frame->contin_data = NULL;
 }
 
 /* Type for a context stack */
@@ -67,10 +65,9 @@ typedef struct {
      is mostly used for debugging. */
   bool in_user_code;
 
-  /* Start and stop timers for measuring the execution time of a
-     strand. */
-  struct timespec start;
-  struct timespec stop;
+  /* Start and stop times of a strand, in ticks of tsc_clock */
+  uint64_t start;
+  uint64_t stop;
 
   /* Pointer to bottom of the stack, onto which frames are pushed. */
   context_stack_frame_t *bot;
@@ -78,28 +75,91 @@ typedef struct {
   /* Running total of work. */
   uint64_t running_wrk;
 
-  /* Data associated with the running work */
-  void* running_wrk_data;
+  /* Work and span of the Cilk functions called from each call site */
+  site_table_t sites;
+
+  /* Frames popped off of the stack, linked through their parent
+     pointers, for reuse by later pushes. */
+  context_stack_frame_t *free_list;
+  /* Last frame on the free list, so that free lists can be spliced in
+     constant time. */
+  context_stack_frame_t *free_list_tail;
 
 } context_stack_t;
 
+/* Returns a frame for the stack *stack, taking it from the stack's
+   free list if possible. */
+context_stack_frame_t* context_stack_frame_alloc(context_stack_t *stack)
+{
+  context_stack_frame_t *frame = stack->free_list;
+  if (NULL != frame) {
+    stack->free_list = frame->parent;
+    if (NULL == stack->free_list)
+      stack->free_list_tail = NULL;
+    return frame;
+  }
+  return (context_stack_frame_t *)malloc(sizeof(context_stack_frame_t));
+}
+
+/* Returns the popped frame *frame to the free list of the stack
+   *stack. */
+void context_stack_frame_free(context_stack_t *stack, context_stack_frame_t *frame)
+{
+  frame->parent = stack->free_list;
+  if (NULL == stack->free_list)
+    stack->free_list_tail = frame;
+  stack->free_list = frame;
+}
+
 /* Initializes the context stack */
 void context_stack_init(context_stack_t *stack, cilk_function_type func_type)
 {
-  context_stack_frame_t *new_frame =
-    (context_stack_frame_t *)malloc(sizeof(context_stack_frame_t));
+  stack->free_list = NULL;
+  stack->free_list_tail = NULL;
+  context_stack_frame_t *new_frame = context_stack_frame_alloc(stack);
   context_stack_frame_init(new_frame, func_type);
   stack->bot = new_frame;
   stack->running_wrk = 0;
-  stack->running_wrk_data = NULL;
+  site_table_init(&(stack->sites));
   stack->in_user_code = false;
 }
 
+/* Frees all frames of the stack *stack, both those on the stack and
+   those on its free list, and its table of call sites. */
+void context_stack_free(context_stack_t *stack)
+{
+  while (NULL != stack->bot) {
+    context_stack_frame_t *old_bottom = stack->bot;
+    stack->bot = old_bottom->parent;
+    free(old_bottom);
+  }
+  while (NULL != stack->free_list) {
+    context_stack_frame_t *frame = stack->free_list;
+    stack->free_list = frame->parent;
+    free(frame);
+  }
+  stack->free_list_tail = NULL;
+  site_table_free(&(stack->sites));
+}
+
+/* Moves the frames on the free list of the stack *from to the free
+   list of the stack *to. */
+void context_stack_merge_free_lists(context_stack_t *to, context_stack_t *from)
+{
+  if (NULL == from->free_list)
+    return;
+  from->free_list_tail->parent = to->free_list;
+  if (NULL == to->free_list)
+    to->free_list_tail = from->free_list_tail;
+  to->free_list = from->free_list;
+  from->free_list = NULL;
+  from->free_list_tail = NULL;
+}
+
 /* Push new frame of function type func_type onto the stack *stack */
 context_stack_frame_t* context_stack_push(context_stack_t *stack, cilk_function_type func_type)
 {
-  context_stack_frame_t *new_frame
-    = (context_stack_frame_t *)malloc(sizeof(context_stack_frame_t));
+  context_stack_frame_t *new_frame = context_stack_frame_alloc(stack);
   context_stack_frame_init(new_frame, func_type);
   new_frame->parent = stack->bot;
   stack->bot = new_frame;
@@ -108,7 +168,8 @@ context_stack_frame_t* context_stack_push(context_stack_t *stack, cilk_function_
 }
 
 /* Pops the bottommost frame off of the stack *stack, and returns a
-   pointer to it. */
+   pointer to it.  The caller returns the frame to the stack with
+   context_stack_frame_free once it is done with it. */
 context_stack_frame_t* context_stack_pop(context_stack_t *stack)
 {
   context_stack_frame_t *old_bottom = stack->bot;
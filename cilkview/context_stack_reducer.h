@@ -35,6 +35,7 @@ void reduce_context_stack(void *reducer, void *l, void *r)
   }
   /* running_wrk is maintained as a sum reducer */
   left->running_wrk += right->running_wrk;
+  site_table_merge(&(left->sites), &(right->sites));
 
   /* assert(0 == left->bot->contin_spn); */
 
@@ -46,12 +47,15 @@ void reduce_context_stack(void *reducer, void *l, void *r)
   } else {
     left->bot->contin_spn += right->bot->prefix_spn + right->bot->contin_spn;
   }
+
+  /* Keep the frames the right view has freed for reuse. */
+  context_stack_merge_free_lists(left, right);
 }
 
 /* Destructor for context stack reducer */
 void destroy_context_stack(void *reducer, void *view)
 {
-  free(((context_stack_t*)view)->bot);
+  context_stack_free((context_stack_t*)view);
 }
 
 #endif
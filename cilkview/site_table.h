@@ -0,0 +1,138 @@
+#ifndef INCLUDED_SITE_TABLE_H
+#define INCLUDED_SITE_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Type for the work and span of the invocations of Cilk functions from
+   one call site */
+typedef struct {
+  /* Return address of the call, or 0 if the slot is empty */
+  uintptr_t rip;
+
+  /* Number of invocations from this call site that have not yet
+     returned */
+  int32_t active;
+
+  /* Number of invocations from this call site */
+  uint64_t invocations;
+
+  /* Work and span of the invocations from this call site, counting only
+     the invocations that are not nested inside another invocation from
+     the same call site, so that recursive calls are not counted more
+     than once */
+  uint64_t wrk;
+  uint64_t spn;
+} site_t;
+
+/* Type for a table of call sites, keyed by rip.  The table is a flat
+   array, searched by linear probing, that is at most half full. */
+typedef struct {
+  /* Log of the capacity of the table */
+  int lg_capacity;
+  /* Number of call sites in the table */
+  int num_sites;
+  /* Array of 2^lg_capacity slots, or NULL until the first call site is
+     added */
+  site_t *sites;
+} site_table_t;
+
+/* Log of the capacity of a table when its first call site is added */
+static const int MIN_SITE_TABLE_LG_CAPACITY = 6;
+
+/* Initializes the table *tab to be empty */
+void site_table_init(site_table_t *tab)
+{
+  tab->lg_capacity = 0;
+  tab->num_sites = 0;
+  tab->sites = NULL;
+}
+
+/* Frees the slots of the table *tab */
+void site_table_free(site_table_t *tab)
+{
+  free(tab->sites);
+  site_table_init(tab);
+}
+
+/* Returns the slot at which to start searching for rip in a table of
+   capacity 2^lg_capacity */
+static inline size_t site_table_hash(uintptr_t rip, int lg_capacity)
+{
+  return (size_t)(((uint64_t)rip * 0x9e3779b97f4a7c15ULL) >> (64 - lg_capacity));
+}
+
+/* Doubles the capacity of the table *tab */
+static void site_table_grow(site_table_t *tab)
+{
+  int new_lg_capacity = (NULL == tab->sites) ?
+    MIN_SITE_TABLE_LG_CAPACITY : tab->lg_capacity + 1;
+  size_t new_mask = ((size_t)1 << new_lg_capacity) - 1;
+  site_t *new_sites = (site_t *)calloc(new_mask + 1, sizeof(site_t));
+
+  if (NULL != tab->sites) {
+    for (size_t i = 0; i < ((size_t)1 << tab->lg_capacity); ++i) {
+      if (0 == tab->sites[i].rip)
+        continue;
+      size_t j = site_table_hash(tab->sites[i].rip, new_lg_capacity);
+      while (0 != new_sites[j].rip)
+        j = (j + 1) & new_mask;
+      new_sites[j] = tab->sites[i];
+    }
+    free(tab->sites);
+  }
+  tab->sites = new_sites;
+  tab->lg_capacity = new_lg_capacity;
+}
+
+/* Returns the slot of the table *tab that holds call site rip, or the
+   empty slot where rip belongs if the table does not hold it.  The
+   table must have slots. */
+static inline site_t* site_table_find(site_table_t *tab, uintptr_t rip)
+{
+  size_t mask = ((size_t)1 << tab->lg_capacity) - 1;
+  size_t i = site_table_hash(rip, tab->lg_capacity);
+  while (rip != tab->sites[i].rip && 0 != tab->sites[i].rip) {
+    i = (i + 1) & mask;
+  }
+  return &(tab->sites[i]);
+}
+
+/* Returns the entry of the table *tab for call site rip, adding an
+   empty entry if there is none.  The table grows only when an entry is
+   added.  The entry is valid only until the next call to
+   site_table_get. */
+static inline site_t* site_table_get(site_table_t *tab, uintptr_t rip)
+{
+  site_t *site = (NULL == tab->sites) ? NULL : site_table_find(tab, rip);
+  if (NULL != site && rip == site->rip) {
+    return site;
+  }
+  if (2 * (tab->num_sites + 1) > (1 << tab->lg_capacity)) {
+    site_table_grow(tab);
+    site = site_table_find(tab, rip);
+  }
+  site->rip = rip;
+  ++tab->num_sites;
+  return site;
+}
+
+/* Adds the call sites of the table *from to the table *to */
+void site_table_merge(site_table_t *to, const site_table_t *from)
+{
+  if (NULL == from->sites)
+    return;
+  for (size_t i = 0; i < ((size_t)1 << from->lg_capacity); ++i) {
+    const site_t *from_site = &(from->sites[i]);
+    if (0 == from_site->rip)
+      continue;
+    site_t *to_site = site_table_get(to, from_site->rip);
+    to_site->active += from_site->active;
+    to_site->invocations += from_site->invocations;
+    to_site->wrk += from_site->wrk;
+    to_site->spn += from_site->spn;
+  }
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef INCLUDED_TSC_CLOCK_H
+#define INCLUDED_TSC_CLOCK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+/* Clock for timing strands.  Reading the clock returns ticks of the
+   time-stamp counter, which costs a single rdtsc, and ticks are
+   converted to nanoseconds only when results are printed.  The rate of
+   the counter is calibrated once against CLOCK_MONOTONIC.  If the
+   processor does not have an invariant TSC, whose rate is constant and
+   which is synchronized across cores, or if CILKVIEW_CLOCK is set to
+   "monotonic", the clock falls back to reading CLOCK_MONOTONIC, whose
+   ticks are nanoseconds. */
+
+/* Time spent calibrating the counter, in nanoseconds */
+static const uint64_t TSC_CALIBRATION_NSEC = 20000000;
+
+typedef struct {
+  /* True if the clock reads the time-stamp counter */
+  bool use_tsc;
+  /* Nanoseconds per tick */
+  double nsec_per_tick;
+} tsc_clock_t;
+
+static tsc_clock_t tsc_clock = { false, 1.0 };
+
+static inline __attribute__((always_inline)) uint64_t rdtsc(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned hi, lo;
+  __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+  return (uint64_t)lo + (((uint64_t)hi) << 32);
+#else
+  return 0;
+#endif
+}
+
+static inline uint64_t monotonic_nsec(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ll + now.tv_nsec;
+}
+
+/* Returns true if the processor reports an invariant TSC. */
+static bool invariant_tsc_p(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+    return false;
+  return 0 != (edx & (1 << 8));
+#else
+  return false;
+#endif
+}
+
+/* Initializes the clock, calibrating the time-stamp counter if it is
+   used. */
+static void tsc_clock_init(void) {
+  const char *e = getenv("CILKVIEW_CLOCK");
+  bool force_monotonic = (NULL != e && 0 == strcmp(e, "monotonic"));
+  if (force_monotonic || !invariant_tsc_p()) {
+    if (!force_monotonic)
+      fprintf(stderr, "No invariant TSC, timing strands with CLOCK_MONOTONIC.\n");
+    tsc_clock.use_tsc = false;
+    tsc_clock.nsec_per_tick = 1.0;
+    return;
+  }
+
+  uint64_t start_nsec = monotonic_nsec();
+  uint64_t start_tick = rdtsc();
+  uint64_t stop_nsec, stop_tick;
+  do {
+    stop_nsec = monotonic_nsec();
+    stop_tick = rdtsc();
+  } while (stop_nsec - start_nsec < TSC_CALIBRATION_NSEC);
+
+  tsc_clock.use_tsc = true;
+  tsc_clock.nsec_per_tick = (stop_nsec - start_nsec) / (double)(stop_tick - start_tick);
+}
+
+/* Returns the current time, in ticks. */
+static inline __attribute__((always_inline)) uint64_t tsc_clock_now(void) {
+  if (__builtin_expect(tsc_clock.use_tsc, true))
+    return rdtsc();
+  return monotonic_nsec();
+}
+
+/* Converts a number of ticks to seconds. */
+static inline double tsc_clock_sec(uint64_t ticks) {
+  return ticks * tsc_clock.nsec_per_tick / 1000000000.0;
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef INCLUDED_CILKPROF_DOT_H
+#define INCLUDED_CILKPROF_DOT_H
+
+#include <cilktool.h>
+
+// Interface that cilkprof provides beyond the hooks in cilktool.h.  Only
+// cilkprof defines these functions, so a program that calls them should
+// include this header and make the calls only when it is built for
+// cilkprof, e.g., under #if CILKPROF.
+
+EXTERN_C
+
+// Profiling regions.  A region opened by cilkprof_region_begin and
+// closed by the matching cilkprof_region_end is reported separately,
+// aggregated over all regions with the same name.  Regions may nest,
+// and must begin and end in the same function.
+void cilkprof_region_begin(const char* name);
+void cilkprof_region_end(void);
+
+EXTERN_C_END
+
+#endif  // INCLUDED_CILKPROF_DOT_H
@@ -18,6 +18,9 @@ void cilk_end_update_strand(void);
 
 void cilk_set_reducer(void *reducer, void *rip, const char *function, int line);
 void cilk_read_reducer(void *reducer, void *rip, const char *function, int line);
+// call when a reducer is destroyed, so that a tool can forget it before
+// its address is reused
+void cilk_destroy_reducer(void *reducer, void *rip, const char *function, int line);
 
 // enclose function definitions with following; use REDUCE_STRAND for
 // reduce operation and UPDATE_STRAND for everything else that updates reducer
@@ -0,0 +1,61 @@
+#ifndef INCLUDED_SPEEDUP_H
+#define INCLUDED_SPEEDUP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Predicted speedup of a computation on P workers, from its work T1
+// and span Tinf, and its burdened span.  Shared by the tools that
+// measure work and span.
+typedef struct {
+  // Work and span laws: min(P, T1/Tinf)
+  double upper;
+  // Greedy-scheduler lower bound: T1 / (T1/P + Tinf)
+  double greedy;
+  // Estimate from the greedy-scheduler bound, with the burdened span in
+  // place of the span
+  double burdened;
+} speedup_t;
+
+// Greedy-scheduler bound T1 / (T1/P + span) on the speedup.  A
+// computation with no measurable span has a speedup of P.
+static inline double greedy_speedup(int P, uint64_t wrk, uint64_t spn) {
+  if (0 == spn)
+    return (double)P;
+  return (double)wrk / ((double)wrk / P + (double)spn);
+}
+
+static inline speedup_t predict_speedup(int P, uint64_t wrk, uint64_t spn,
+                                        uint64_t bspn) {
+  speedup_t s;
+  double parallelism = (double)wrk / (double)spn;
+  s.upper = (0 == spn || P < parallelism) ? (double)P : parallelism;
+  s.greedy = greedy_speedup(P, wrk, spn);
+  s.burdened = greedy_speedup(P, wrk, bspn);
+  return s;
+}
+
+// Largest number of workers to predict speedup for, which is read from
+// the environment variable var and defaults to the number of online
+// processors.  A value of 0 turns the prediction off.  A value of var
+// that is not a non-negative integer is reported and ignored.
+static inline int speedup_max_workers(const char *var) {
+  long max_workers = sysconf(_SC_NPROCESSORS_ONLN);
+  if (max_workers <= 0)
+    max_workers = 1;
+  const char *e = getenv(var);
+  if (NULL != e) {
+    char *end;
+    long P = strtol(e, &end, 10);
+    if (end == e || '\0' != *end || P < 0 || P > INT32_MAX) {
+      fprintf(stderr, "Ignoring %s=%s, which is not a non-negative integer.\n", var, e);
+    } else {
+      max_workers = P;
+    }
+  }
+  return (int)max_workers;
+}
+
+#endif
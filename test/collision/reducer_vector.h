@@ -187,6 +187,7 @@ template<class _T, class _A>
 hypervector<_T, _A>::~hypervector()
 {
   //fprintf(stderr, "deleting\n");
+  cilk_destroy_reducer(this, __builtin_return_address(0), __FUNCTION__, __LINE__);
   BEGIN_UPDATE_STRAND_NOSCOPE;
   if (head != NULL) {
     delete head->vec;
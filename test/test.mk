@@ -3,7 +3,7 @@ TOOL_LC = $(shell echo $(TOOL) | tr A-Z a-z)
 include $(TOOL_HOME)/$(TOOL_LC)/appflags.mk
 endif
 
-.PHONY : default clean clean$(TEST)
+.PHONY : default clean clean$(TEST) cilkview-scale cilkview-parallel
 
 # $(TEST).d : CFLAGS += $(APP_CFLAGS)
 # $(TEST).d : CXXFLAGS += $(APP_CFLAGS)
@@ -19,6 +19,50 @@ LDLIBS += $(APP_LDLIBS)
 clean : clean$(TEST)
 
 clean$(TEST) :
-	rm -f $(ALL_TESTS) *.o *.d* *~
+	rm -f $(ALL_TESTS) *.o *.d* *~ *.cilkview *.pcilkview *.scale.csv *.scale.json
+
+# Speedup curve of one test against the bounds cilkview predicts, e.g.
+#   make cilkview-scale SCALE_PROG=fib SCALE_ARGS=30
+# SCALE_PROG is built with cilkview as SCALE_PROG.cilkview and without a
+# tool, and the output of cilkview-scale is written to
+# SCALE_PROG.scale.$(SCALE_FORMAT).
+SCALE_FORMAT ?= csv
+SCALE_FLAGS ?=
+
+cilkview-scale :
+	$(MAKE) -C $(TOOL_HOME) TOOL=cilkview
+	$(MAKE) clean$(TEST)
+	$(MAKE) TOOL=cilkview $(SCALE_PROG)
+	mv $(SCALE_PROG) $(SCALE_PROG).cilkview
+	rm -f *.o
+	$(MAKE) TOOL= $(SCALE_PROG)
+	$(TOOL_HOME)/cilkview/cilkview-scale -f $(SCALE_FORMAT) $(SCALE_FLAGS) \
+	  ./$(SCALE_PROG).cilkview ./$(SCALE_PROG) $(SCALE_ARGS) \
+	  > $(SCALE_PROG).scale.$(SCALE_FORMAT)
+
+# Work and span that cilkview built with PARALLEL=1 measures on several
+# workers against those of the serial cilkview, e.g.
+#   make cilkview-parallel CHECK_PROG=quicksort CHECK_ARGS="-n 10000000"
+# CHECK_PROG is built with the serial cilkview as CHECK_PROG.cilkview
+# and with the parallel cilkview as CHECK_PROG.pcilkview, and the serial
+# cilkview library is rebuilt before the check.  CHECK_FLAGS is passed
+# to cilkview-parallel-check.
+CHECK_FLAGS ?=
+
+cilkview-parallel :
+	$(MAKE) -C $(TOOL_HOME) cleancilkview
+	$(MAKE) -C $(TOOL_HOME) TOOL=cilkview
+	$(MAKE) clean$(TEST)
+	$(MAKE) TOOL=cilkview $(CHECK_PROG)
+	mv $(CHECK_PROG) $(CHECK_PROG).cilkview
+	rm -f *.o
+	$(MAKE) -C $(TOOL_HOME) cleancilkview
+	$(MAKE) -C $(TOOL_HOME) TOOL=cilkview PARALLEL=1
+	$(MAKE) TOOL=cilkview $(CHECK_PROG)
+	mv $(CHECK_PROG) $(CHECK_PROG).pcilkview
+	$(MAKE) -C $(TOOL_HOME) cleancilkview
+	$(MAKE) -C $(TOOL_HOME) TOOL=cilkview
+	$(TOOL_HOME)/cilkview/cilkview-parallel-check $(CHECK_FLAGS) \
+	  ./$(CHECK_PROG).cilkview ./$(CHECK_PROG).pcilkview $(CHECK_ARGS)
 
 -include $(patsubst %,%.d, $(ALL_TESTS))
@@ -0,0 +1 @@
+LDLIBS += -ltrace -lpthread
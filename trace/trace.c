@@ -1,11 +1,394 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <inttypes.h>
 #include <string.h>
 #include <assert.h>
+#include <err.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
-#include "cilktool.h"
+#include <cilktool.h>
+
+/* Set SERIAL_TOOL to 0, or build with PARALLEL=1, to record the Cilk
+   worker number of each event, which requires the Cilk runtime headers.
+   Otherwise each event records the number of its thread, counting
+   threads in the order of their first events. */
+#ifndef SERIAL_TOOL
+#define SERIAL_TOOL 1
+#endif
+
+#if !SERIAL_TOOL
+#include <cilk/cilk_api.h>
+#endif
+
+#include "trace_format.h"
+
+/* Tracing tool.  Each hook appends a fixed-size record of its event to a
+   ring buffer owned by the calling thread.  A background thread, the
+   flusher, copies the records from the ring buffers into the trace
+   file, which is mapped into memory.  The ring buffers are lock-free,
+   with a single producer, the thread that owns the buffer, and a single
+   consumer, the flusher.  If a ring buffer fills, its thread waits for
+   the flusher to drain it, so no events are lost.
+
+   The trace is written to the file named by CILKTRACE_FILE, or to
+   DEFAULT_TRACE_FILE, and is finished when cilk_tool_destroy is called
+   or when the program exits.  Use trace_decode to read it. */
+
+/* Log of the number of records in the ring buffer of each thread */
+#ifndef TRACE_BUFFER_LG_RECORDS
+#define TRACE_BUFFER_LG_RECORDS 16
+#endif
+
+/* Time the flusher sleeps when it finds the ring buffers empty, in
+   nanoseconds */
+#ifndef TRACE_FLUSH_INTERVAL_NSEC
+#define TRACE_FLUSH_INTERVAL_NSEC 1000000
+#endif
+
+#define TRACE_BUFFER_RECORDS ((uint64_t)1 << TRACE_BUFFER_LG_RECORDS)
+
+/* Amount by which the trace file grows, in bytes */
+#define TRACE_FILE_CHUNK ((size_t)64 << 20)
+
+/* Minimum time over which the rate of the clock is measured, in
+   nanoseconds */
+#define TRACE_MIN_CALIBRATION_NSEC 10000000
+
+#define DEFAULT_TRACE_FILE "cilk.trace"
+
+/* Ring buffer of the records of one thread.  Records are numbered from
+   the start of the trace, and record i is stored in records[i mod
+   TRACE_BUFFER_RECORDS].  The indices written by the producer and by the
+   consumer are kept on separate cache lines. */
+typedef struct trace_buffer_t {
+  /* Index of the next record to write, written only by the owner */
+  uint64_t head __attribute__((aligned(64)));
+  /* Value of tail when the owner last read it.  The owner reads tail
+     only when the buffer looks full according to cached_tail. */
+  uint64_t cached_tail;
+
+  /* Index of the next record to flush, written only by the flusher */
+  uint64_t tail __attribute__((aligned(64)));
+  /* Next buffer in the list of all buffers */
+  struct trace_buffer_t *next;
+  /* Number of the owner, in the order in which threads first recorded
+     events */
+  int16_t thread_num;
+
+  trace_record_t records[TRACE_BUFFER_RECORDS] __attribute__((aligned(64)));
+} trace_buffer_t;
+
+typedef enum {
+  TRACE_UNINITIALIZED,
+  TRACE_RUNNING,
+  TRACE_STOPPED,
+} trace_state_t;
+
+/* State of the trace file and of the flusher */
+typedef struct {
+  const char *path;
+  int fd;
+  /* Mapping of the whole file, of size map_size */
+  char *map;
+  size_t map_size;
+  /* Bytes written to the file, including the header */
+  size_t size;
+
+  pthread_t flusher;
+  /* Set to stop the flusher once it has drained the buffers */
+  bool stop;
+
+  /* Times when tracing started, in ticks and in nanoseconds */
+  uint64_t start_tick;
+  uint64_t start_nsec;
+
+  /* Number of threads that recorded events */
+  uint32_t num_threads;
+} trace_output_t;
+
+static trace_output_t trace_out;
+
+static trace_state_t trace_state = TRACE_UNINITIALIZED;
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+
+/* List of the ring buffers of all threads.  Buffers are only ever added
+   to the front of the list. */
+static trace_buffer_t *trace_buffers = NULL;
+
+/* Ring buffer of this thread, or NULL before its first event */
+static __thread trace_buffer_t *my_buffer = NULL;
+
+/*************************************************************************/
+/**
+ * Clock
+ */
+
+static inline uint64_t monotonic_nsec(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ll + now.tv_nsec;
+}
+
+/* Returns the current time, in ticks of the time-stamp counter.  The
+   rate of the counter is measured against CLOCK_MONOTONIC over the
+   whole run, when the trace is finished. */
+static inline __attribute__((always_inline)) uint64_t trace_clock_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned hi, lo;
+  __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+  return (uint64_t)lo + (((uint64_t)hi) << 32);
+#else
+  return monotonic_nsec();
+#endif
+}
+
+/*************************************************************************/
+/**
+ * Flusher
+ */
+
+/* Makes room for bytes more bytes in the trace file. */
+static void trace_file_reserve(size_t bytes) {
+  if (trace_out.size + bytes <= trace_out.map_size)
+    return;
+
+  size_t new_map_size = trace_out.map_size;
+  while (new_map_size < trace_out.size + bytes)
+    new_map_size += TRACE_FILE_CHUNK;
+  if (ftruncate(trace_out.fd, new_map_size) < 0) {
+    err(1, "cannot grow trace file %s", trace_out.path);
+  }
+  void *map = mremap(trace_out.map, trace_out.map_size, new_map_size, MREMAP_MAYMOVE);
+  if (MAP_FAILED == map) {
+    err(1, "cannot map trace file %s", trace_out.path);
+  }
+  trace_out.map = (char *)map;
+  trace_out.map_size = new_map_size;
+}
+
+/* Copies the records in *buf to the trace file, and returns the number
+   of records copied. */
+static uint64_t trace_flush_buffer(trace_buffer_t *buf) {
+  uint64_t head = __atomic_load_n(&buf->head, __ATOMIC_ACQUIRE);
+  uint64_t tail = buf->tail;
+  uint64_t num_records = head - tail;
+  if (0 == num_records)
+    return 0;
+
+  trace_file_reserve(num_records * sizeof(trace_record_t));
+
+  /* The records may wrap around the end of the ring. */
+  uint64_t first = tail & (TRACE_BUFFER_RECORDS - 1);
+  uint64_t num_first = TRACE_BUFFER_RECORDS - first;
+  if (num_first > num_records)
+    num_first = num_records;
+  memcpy(trace_out.map + trace_out.size, &(buf->records[first]),
+         num_first * sizeof(trace_record_t));
+  memcpy(trace_out.map + trace_out.size + num_first * sizeof(trace_record_t),
+         &(buf->records[0]), (num_records - num_first) * sizeof(trace_record_t));
+  trace_out.size += num_records * sizeof(trace_record_t);
+
+  __atomic_store_n(&buf->tail, head, __ATOMIC_RELEASE);
+  return num_records;
+}
+
+static void* trace_flusher(void *arg) {
+  const struct timespec interval = { 0, TRACE_FLUSH_INTERVAL_NSEC };
+  while (true) {
+    /* Records written before stop was set are flushed by this pass. */
+    bool stop = __atomic_load_n(&trace_out.stop, __ATOMIC_ACQUIRE);
+    uint64_t flushed = 0;
+    for (trace_buffer_t *buf = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE);
+         NULL != buf; buf = buf->next) {
+      flushed += trace_flush_buffer(buf);
+    }
+    if (stop && 0 == flushed)
+      break;
+    if (0 == flushed)
+      nanosleep(&interval, NULL);
+  }
+  return NULL;
+}
+
+/*************************************************************************/
+/**
+ * Setup and shutdown
+ */
+
+static void trace_shutdown(void);
+
+static void trace_setup(void) {
+  trace_out.path = getenv("CILKTRACE_FILE");
+  if (NULL == trace_out.path || '\0' == trace_out.path[0])
+    trace_out.path = DEFAULT_TRACE_FILE;
+
+  trace_out.fd = open(trace_out.path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (trace_out.fd < 0) {
+    err(1, "cannot open trace file %s", trace_out.path);
+  }
+  trace_out.map_size = TRACE_FILE_CHUNK;
+  if (ftruncate(trace_out.fd, trace_out.map_size) < 0) {
+    err(1, "cannot grow trace file %s", trace_out.path);
+  }
+  void *map = mmap(NULL, trace_out.map_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, trace_out.fd, 0);
+  if (MAP_FAILED == map) {
+    err(1, "cannot map trace file %s", trace_out.path);
+  }
+  trace_out.map = (char *)map;
+  trace_out.size = sizeof(trace_header_t);
+  trace_out.stop = false;
+  trace_out.num_threads = 0;
+
+  trace_out.start_nsec = monotonic_nsec();
+  trace_out.start_tick = trace_clock_now();
+
+  int ret = pthread_create(&trace_out.flusher, NULL, trace_flusher, NULL);
+  if (0 != ret) {
+    errx(1, "cannot create flusher: %s", strerror(ret));
+  }
+  atexit(trace_shutdown);
+
+  __atomic_store_n(&trace_state, TRACE_RUNNING, __ATOMIC_RELEASE);
+}
+
+/* Stops tracing, and finishes the trace file.  The ring buffers are not
+   freed, since another thread may still be appending to its buffer. */
+static void trace_shutdown(void) {
+  trace_state_t running = TRACE_RUNNING;
+  if (!__atomic_compare_exchange_n(&trace_state, &running, TRACE_STOPPED, false,
+                                   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+    return;
+
+  __atomic_store_n(&trace_out.stop, true, __ATOMIC_RELEASE);
+  pthread_join(trace_out.flusher, NULL);
+
+  uint64_t stop_nsec, stop_tick;
+  do {
+    stop_nsec = monotonic_nsec();
+    stop_tick = trace_clock_now();
+  } while (stop_nsec - trace_out.start_nsec < TRACE_MIN_CALIBRATION_NSEC);
+
+  trace_header_t *header = (trace_header_t *)trace_out.map;
+  memset(header, 0, sizeof(trace_header_t));
+  memcpy(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  header->version = TRACE_VERSION;
+  header->record_size = sizeof(trace_record_t);
+  header->num_records = (trace_out.size - sizeof(trace_header_t)) / sizeof(trace_record_t);
+  header->start_tick = trace_out.start_tick;
+  header->ticks_per_nsec = (stop_tick - trace_out.start_tick) /
+    (double)(stop_nsec - trace_out.start_nsec);
+  header->num_threads = trace_out.num_threads;
+
+  munmap(trace_out.map, trace_out.map_size);
+  trace_out.map = NULL;
+  if (ftruncate(trace_out.fd, trace_out.size) < 0) {
+    err(1, "cannot truncate trace file %s", trace_out.path);
+  }
+  close(trace_out.fd);
+}
+
+/* Returns the ring buffer of this thread, setting up tracing and the
+   buffer if necessary, or NULL if tracing has stopped. */
+static trace_buffer_t* trace_buffer_get(void) {
+  pthread_once(&trace_once, trace_setup);
+  if (TRACE_RUNNING != __atomic_load_n(&trace_state, __ATOMIC_ACQUIRE))
+    return NULL;
+
+  if (NULL == my_buffer) {
+    trace_buffer_t *buf;
+    if (0 != posix_memalign((void **)&buf, 64, sizeof(trace_buffer_t))) {
+      errx(1, "cannot allocate trace buffer");
+    }
+    buf->head = 0;
+    buf->cached_tail = 0;
+    buf->tail = 0;
+    buf->next = __atomic_load_n(&trace_buffers, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&trace_buffers, &buf->next, buf, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+      ;
+    buf->thread_num = __atomic_fetch_add(&trace_out.num_threads, 1, __ATOMIC_RELAXED);
+    my_buffer = buf;
+  }
+  return my_buffer;
+}
+
+/* Waits until the flusher makes room in *buf.  Returns false if tracing
+   stops first. */
+static bool trace_buffer_wait(trace_buffer_t *buf) {
+  while (true) {
+    buf->cached_tail = __atomic_load_n(&buf->tail, __ATOMIC_ACQUIRE);
+    if (buf->head - buf->cached_tail < TRACE_BUFFER_RECORDS)
+      return true;
+    if (TRACE_RUNNING != __atomic_load_n(&trace_state, __ATOMIC_ACQUIRE))
+      return false;
+    sched_yield();
+  }
+}
+
+/* Appends a record of an event to the ring buffer of this thread. */
+static inline __attribute__((always_inline))
+void trace_event(trace_event_t type, void *sf, void *rip, uint32_t arg) {
+  trace_buffer_t *buf = my_buffer;
+  if (__builtin_expect(NULL == buf ||
+                       TRACE_RUNNING != __atomic_load_n(&trace_state, __ATOMIC_RELAXED),
+                       false)) {
+    buf = trace_buffer_get();
+    if (NULL == buf)
+      return;
+  }
+
+  uint64_t head = buf->head;
+  if (__builtin_expect(head - buf->cached_tail == TRACE_BUFFER_RECORDS, false)) {
+    if (!trace_buffer_wait(buf))
+      return;
+  }
+
+  trace_record_t *record = &(buf->records[head & (TRACE_BUFFER_RECORDS - 1)]);
+  record->tick = trace_clock_now();
+  record->sf = (uintptr_t)sf;
+  record->rip = (uintptr_t)rip;
+#if SERIAL_TOOL
+  record->worker = buf->thread_num;
+#else
+  record->worker = __cilkrts_get_worker_number();
+#endif
+  record->type = type;
+  record->arg = arg;
+  __atomic_store_n(&buf->head, head + 1, __ATOMIC_RELEASE);
+}
+
+#define CALLER_RIP __builtin_extract_return_addr(__builtin_return_address(0))
+
+/*************************************************************************/
+/**
+ * Main tool methods.
+ */
+
+void cilk_tool_init(void) {
+  trace_buffer_get();
+}
+
+void cilk_tool_destroy(void) {
+  trace_shutdown();
+}
+
+void cilk_tool_print(void) {
+  if (TRACE_STOPPED == __atomic_load_n(&trace_state, __ATOMIC_ACQUIRE)) {
+    fprintf(stderr, "Trace of %" PRIu64 " events written to %s.\n",
+            (uint64_t)((trace_out.size - sizeof(trace_header_t)) / sizeof(trace_record_t)),
+            trace_out.path);
+  } else if (TRACE_RUNNING == __atomic_load_n(&trace_state, __ATOMIC_ACQUIRE)) {
+    fprintf(stderr, "Tracing to %s.\n", trace_out.path);
+  }
+}
 
 /*************************************************************************/
 /**
@@ -14,62 +397,65 @@
 
 void cilk_enter_begin(uint32_t prop, __cilkrts_stack_frame *sf, void *this_fn, void *rip)
 {
-  fprintf(stderr, "cilk_enter_begin(prop = %d, sf = %p, this_fn = %p, rip = %p)\n", prop, sf, this_fn, rip);
+  trace_event(TRACE_ENTER_BEGIN, sf, rip, prop);
 }
 
 void cilk_enter_helper_begin(__cilkrts_stack_frame *sf, void *this_fn, void *rip)
 {
-  fprintf(stderr, "cilk_enter_helper_begin(sf = %p, this_fn = %p, rip = %p)\n", sf, this_fn, rip);
+  trace_event(TRACE_ENTER_HELPER_BEGIN, sf, rip, 0);
 }
 
 void cilk_enter_end(__cilkrts_stack_frame *sf, void *rsp)
 {
-  fprintf(stderr, "cilk_enter_end(sf = %p, rsp = %p)\n", sf, rsp);
+  trace_event(TRACE_ENTER_END, sf, CALLER_RIP, 0);
 }
 
 void cilk_spawn_prepare(__cilkrts_stack_frame *sf)
 {
-  fprintf(stderr, "cilk_spawn_prepare(%p)\n", sf);
+  trace_event(TRACE_SPAWN_PREPARE, sf, CALLER_RIP, 0);
 }
 
 void cilk_spawn_or_continue(int in_continuation)
 {
-  if (in_continuation) {
-    // In the continuation
-    fprintf(stderr, "cilk_spawn_or_continue(CONTINUATION)\n");
-  } else {
-    // In the spawn
-    fprintf(stderr, "cilk_spawn_or_continue(SPAWN)\n");
-  }
+  trace_event(TRACE_SPAWN_OR_CONTINUE, NULL, CALLER_RIP, in_continuation);
 }
 
 void cilk_detach_begin(__cilkrts_stack_frame *parent)
 {
-  fprintf(stderr, "cilk_detach_begin(parent = %p)\n", parent);
+  trace_event(TRACE_DETACH_BEGIN, parent, CALLER_RIP, 0);
 }
 
 void cilk_detach_end(void)
 {
-  fprintf(stderr, "cilk_detach_end()\n");
+  trace_event(TRACE_DETACH_END, NULL, CALLER_RIP, 0);
 }
 
 void cilk_sync_begin(__cilkrts_stack_frame *sf)
 {
-  fprintf(stderr, "cilk_sync_begin(sf = %p)\n", sf);
+  trace_event(TRACE_SYNC_BEGIN, sf, CALLER_RIP, 0);
 }
 
 void cilk_sync_end(__cilkrts_stack_frame *sf)
 {
-  fprintf(stderr, "cilk_sync_end(sf = %p)\n", sf);
+  trace_event(TRACE_SYNC_END, sf, CALLER_RIP, 0);
 }
 
 void cilk_leave_begin(__cilkrts_stack_frame *sf)
 {
-  fprintf(stderr, "cilk_leave_begin(sf = %p)\n", sf);
+  trace_event(TRACE_LEAVE_BEGIN, sf, CALLER_RIP, 0);
 }
 
 void cilk_leave_end(void)
 {
-  fprintf(stderr, "cilk_leave_end()\n");
+  trace_event(TRACE_LEAVE_END, NULL, CALLER_RIP, 0);
+}
+
+void cilk_tool_c_function_enter(uint32_t prop, void *this_fn, void *rip)
+{
+  trace_event(TRACE_C_FUNCTION_ENTER, NULL, rip, prop);
 }
 
+void cilk_tool_c_function_leave(void *rip)
+{
+  trace_event(TRACE_C_FUNCTION_LEAVE, NULL, rip, 0);
+}
@@ -0,0 +1,30 @@
+LIBTRACE = $(LIB_DIR)/libtrace.a
+# The decoder is built in the trace directory, both from here and from
+# the top-level Makefile.
+TRACE_DECODE = $(dir $(LIB_DIR))trace/trace_decode
+
+TRACE_SRC = trace.c trace_decode.c
+TRACE_OBJ = $(TRACE_SRC:.c=.o)
+
+-include $(TRACE_OBJ:.o=.d)
+
+CFLAGS += $(TOOL_CFLAGS)
+LDFLAGS += $(TOOL_LDFLAGS)
+LDLIBS += $(TOOL_LDLIBS)
+
+ifeq ($(PARALLEL),1)
+CFLAGS += -DSERIAL_TOOL=0 -fcilkplus
+endif
+
+.PHONY : cleantrace
+
+default : $(LIBTRACE) $(TRACE_DECODE)
+clean : cleantrace
+
+$(LIBTRACE) : trace.o
+
+$(TRACE_DECODE) : trace_decode.o
+	$(CC) $(LDFLAGS) $^ $(LDLIBS) -o $@
+
+cleantrace :
+	rm -f $(LIBTRACE) $(TRACE_DECODE) $(TRACE_OBJ) $(TRACE_OBJ:.o=.d*) *~
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include <err.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace_format.h"
+
+/* Decoder of the trace files written by the tracing tool:
+ *
+ *   trace_decode [-f text|chrome] FILE
+ *
+ * prints the events in FILE in order of time, either as text, one event
+ * per line, or in the JSON format of Chrome's trace viewer.  In the
+ * Chrome format, each invocation of a Cilk function or spawn helper is a
+ * span on the timeline of the worker that entered it, from its
+ * enter_begin to its leave_begin, and the other Cilk events are instant
+ * events on the timeline of the worker that recorded them.  An
+ * invocation that returns on a different worker from the one that
+ * entered it is still drawn on the timeline of the worker that entered
+ * it, with the worker that returned from it as an argument.
+ */
+
+static const char *trace_event_names[TRACE_NUM_EVENT_TYPES] = {
+  "enter_begin",
+  "enter_helper_begin",
+  "enter_end",
+  "spawn_prepare",
+  "spawn_or_continue",
+  "detach_begin",
+  "detach_end",
+  "sync_begin",
+  "sync_end",
+  "leave_begin",
+  "leave_end",
+  "c_function_enter",
+  "c_function_leave",
+};
+
+static const trace_header_t *header;
+static const trace_record_t *records;
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-f text|chrome] FILE\n", prog);
+  exit(1);
+}
+
+/* Returns the time of record r since the start of tracing, in
+   microseconds. */
+static double record_usec(const trace_record_t *r) {
+  return (int64_t)(r->tick - header->start_tick) / header->ticks_per_nsec / 1000.0;
+}
+
+/* Orders record indices by time, keeping the order in the file for
+   records with the same time. */
+static int compare_time(const void *a, const void *b) {
+  const trace_record_t *ra = &(records[*(const uint64_t *)a]);
+  const trace_record_t *rb = &(records[*(const uint64_t *)b]);
+  if (ra->tick != rb->tick)
+    return (ra->tick < rb->tick) ? -1 : 1;
+  return (*(const uint64_t *)a < *(const uint64_t *)b) ? -1 : 1;
+}
+
+/* Orders record indices by stack frame, and then by time, so that the
+   enter_begin of each invocation is followed by its leave_begin.  Two
+   invocations with the same stack frame never overlap in time. */
+static int compare_frame(const void *a, const void *b) {
+  const trace_record_t *ra = &(records[*(const uint64_t *)a]);
+  const trace_record_t *rb = &(records[*(const uint64_t *)b]);
+  if (ra->sf != rb->sf)
+    return (ra->sf < rb->sf) ? -1 : 1;
+  return compare_time(a, b);
+}
+
+static void print_text(const uint64_t *order, uint64_t num_records) {
+  printf("# %" PRIu64 " events from %" PRIu32 " threads, %f ticks per ns\n",
+         num_records, header->num_threads, header->ticks_per_nsec);
+  printf("# time (us), worker, event, sf, rip\n");
+  for (uint64_t i = 0; i < num_records; ++i) {
+    const trace_record_t *r = &(records[order[i]]);
+    printf("%14.3f %4d %-18s sf=0x%" PRIx64 " rip=0x%" PRIx64,
+           record_usec(r), r->worker, trace_event_names[r->type], r->sf, r->rip);
+    switch (r->type) {
+    case TRACE_ENTER_BEGIN:
+    case TRACE_C_FUNCTION_ENTER:
+      printf(" prop=%" PRIu32, r->arg);
+      break;
+    case TRACE_SPAWN_OR_CONTINUE:
+      printf(" %s", r->arg ? "continuation" : "spawn");
+      break;
+    }
+    printf("\n");
+  }
+}
+
+/* Prints one event in the Chrome trace format. */
+static void print_chrome_event(bool *first, const char *fmt, ...)
+  __attribute__((format(printf, 2, 3)));
+
+static void print_chrome_event(bool *first, const char *fmt, ...) {
+  va_list ap;
+  printf("%s\n    ", *first ? "" : ",");
+  *first = false;
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+}
+
+static void print_chrome(const uint64_t *order, uint64_t num_records) {
+  bool first = true;
+  printf("{\n  \"displayTimeUnit\": \"ns\",\n  \"traceEvents\": [");
+
+  /* Names of the timelines of the workers */
+  int max_worker = -1;
+  bool non_worker = false;
+  for (uint64_t i = 0; i < num_records; ++i) {
+    if (records[i].worker > max_worker)
+      max_worker = records[i].worker;
+    if (records[i].worker < 0)
+      non_worker = true;
+  }
+  for (int w = 0; w <= max_worker; ++w) {
+    print_chrome_event(&first, "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+                       "\"tid\": %d, \"args\": { \"name\": \"worker %d\" } }", w, w);
+  }
+  if (non_worker) {
+    print_chrome_event(&first, "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+                       "\"tid\": -1, \"args\": { \"name\": \"non-worker threads\" } }");
+  }
+
+  /* Instant events */
+  for (uint64_t i = 0; i < num_records; ++i) {
+    const trace_record_t *r = &(records[order[i]]);
+    switch (r->type) {
+    case TRACE_SPAWN_PREPARE:
+    case TRACE_DETACH_BEGIN:
+    case TRACE_SYNC_BEGIN:
+    case TRACE_SYNC_END:
+      print_chrome_event(&first, "{ \"name\": \"%s\", \"cat\": \"cilk\", \"ph\": \"i\", "
+                         "\"s\": \"t\", \"ts\": %.3f, \"pid\": 0, \"tid\": %d, "
+                         "\"args\": { \"sf\": \"0x%" PRIx64 "\", \"rip\": \"0x%" PRIx64 "\" } }",
+                         trace_event_names[r->type], record_usec(r), r->worker,
+                         r->sf, r->rip);
+      break;
+    case TRACE_SPAWN_OR_CONTINUE:
+      print_chrome_event(&first, "{ \"name\": \"%s\", \"cat\": \"cilk\", \"ph\": \"i\", "
+                         "\"s\": \"t\", \"ts\": %.3f, \"pid\": 0, \"tid\": %d, "
+                         "\"args\": { \"rip\": \"0x%" PRIx64 "\" } }",
+                         r->arg ? "continuation" : "spawn", record_usec(r), r->worker,
+                         r->rip);
+      break;
+    }
+  }
+
+  /* Invocations, from the records of entering and leaving frames */
+  uint64_t *frame_order = (uint64_t *)malloc(num_records * sizeof(uint64_t));
+  uint64_t num_frame_records = 0;
+  for (uint64_t i = 0; i < num_records; ++i) {
+    switch (records[i].type) {
+    case TRACE_ENTER_BEGIN:
+    case TRACE_ENTER_HELPER_BEGIN:
+    case TRACE_LEAVE_BEGIN:
+      frame_order[num_frame_records++] = i;
+      break;
+    }
+  }
+  qsort(frame_order, num_frame_records, sizeof(uint64_t), compare_frame);
+
+  double end_usec = (num_records > 0) ? record_usec(&(records[order[num_records - 1]])) : 0.0;
+  for (uint64_t i = 0; i < num_frame_records; ++i) {
+    const trace_record_t *enter = &(records[frame_order[i]]);
+    if (TRACE_LEAVE_BEGIN == enter->type)
+      continue;
+    const trace_record_t *leave = NULL;
+    if (i + 1 < num_frame_records) {
+      const trace_record_t *next = &(records[frame_order[i + 1]]);
+      if (next->sf == enter->sf && TRACE_LEAVE_BEGIN == next->type) {
+        leave = next;
+        ++i;
+      }
+    }
+    double begin = record_usec(enter);
+    double end = (NULL != leave) ? record_usec(leave) : end_usec;
+    print_chrome_event(&first, "{ \"name\": \"%s 0x%" PRIx64 "\", \"cat\": \"cilk\", "
+                       "\"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 0, \"tid\": %d, "
+                       "\"args\": { \"sf\": \"0x%" PRIx64 "\", \"left on worker\": %d } }",
+                       (TRACE_ENTER_HELPER_BEGIN == enter->type) ? "spawn helper" : "function",
+                       enter->rip, begin, end - begin, enter->worker, enter->sf,
+                       (NULL != leave) ? leave->worker : enter->worker);
+  }
+  free(frame_order);
+
+  printf("\n  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *format = "text";
+  int opt;
+  while ((opt = getopt(argc, argv, "f:")) != -1) {
+    switch (opt) {
+    case 'f':
+      format = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind + 1 != argc ||
+      (0 != strcmp(format, "text") && 0 != strcmp(format, "chrome"))) {
+    usage(argv[0]);
+  }
+  const char *path = argv[optind];
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    err(1, "cannot open %s", path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    err(1, "cannot stat %s", path);
+  }
+  if ((size_t)st.st_size < sizeof(trace_header_t)) {
+    errx(1, "%s is not a trace file", path);
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (MAP_FAILED == map) {
+    err(1, "cannot map %s", path);
+  }
+  header = (const trace_header_t *)map;
+  if (0 != memcmp(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC))) {
+    errx(1, "%s is not a trace file", path);
+  }
+  if (TRACE_VERSION != header->version || sizeof(trace_record_t) != header->record_size) {
+    errx(1, "%s has version %" PRIu32 " of the trace format, not %d",
+         path, header->version, TRACE_VERSION);
+  }
+  uint64_t num_records = header->num_records;
+  if (num_records > (st.st_size - sizeof(trace_header_t)) / sizeof(trace_record_t)) {
+    errx(1, "%s is truncated", path);
+  }
+  records = (const trace_record_t *)(header + 1);
+  for (uint64_t i = 0; i < num_records; ++i) {
+    if (records[i].type >= TRACE_NUM_EVENT_TYPES) {
+      errx(1, "%s has an event of unknown type %u", path, records[i].type);
+    }
+  }
+
+  uint64_t *order = (uint64_t *)malloc(num_records * sizeof(uint64_t));
+  for (uint64_t i = 0; i < num_records; ++i)
+    order[i] = i;
+  qsort(order, num_records, sizeof(uint64_t), compare_time);
+
+  if (0 == strcmp(format, "text"))
+    print_text(order, num_records);
+  else
+    print_chrome(order, num_records);
+
+  free(order);
+  munmap(map, st.st_size);
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef INCLUDED_TRACE_FORMAT_H
+#define INCLUDED_TRACE_FORMAT_H
+
+#include <inttypes.h>
+
+/* Layout of a trace file.  A trace file starts with a trace_header_t,
+   followed by num_records records of type trace_record_t.  Records from
+   one worker appear in the order in which they were recorded, but the
+   records of different workers are interleaved in chunks, so readers
+   sort the records by timestamp. */
+
+#define TRACE_MAGIC "CILKTRC"
+#define TRACE_VERSION 1
+
+/* Types of events */
+typedef enum {
+  TRACE_ENTER_BEGIN = 0,
+  TRACE_ENTER_HELPER_BEGIN,
+  TRACE_ENTER_END,
+  TRACE_SPAWN_PREPARE,
+  TRACE_SPAWN_OR_CONTINUE,
+  TRACE_DETACH_BEGIN,
+  TRACE_DETACH_END,
+  TRACE_SYNC_BEGIN,
+  TRACE_SYNC_END,
+  TRACE_LEAVE_BEGIN,
+  TRACE_LEAVE_END,
+  TRACE_C_FUNCTION_ENTER,
+  TRACE_C_FUNCTION_LEAVE,
+  TRACE_NUM_EVENT_TYPES,
+} trace_event_t;
+
+/* Header of a trace file */
+typedef struct {
+  /* TRACE_MAGIC, padded with zeros */
+  char magic[8];
+  uint32_t version;
+  /* sizeof(trace_record_t) */
+  uint32_t record_size;
+  /* Number of records that follow the header */
+  uint64_t num_records;
+  /* Timestamp when tracing started, in ticks */
+  uint64_t start_tick;
+  /* Rate of the clock that produced the timestamps, in ticks per
+     nanosecond, measured over the whole run */
+  double ticks_per_nsec;
+  /* Number of threads that recorded events */
+  uint32_t num_threads;
+  uint32_t pad;
+} trace_header_t;
+
+/* Record of one event */
+typedef struct {
+  /* Time of the event, in ticks */
+  uint64_t tick;
+  /* Stack frame of the event, or 0 if the event has none */
+  uint64_t sf;
+  /* Return address of the hook's caller, or the rip argument of the
+     hook if it has one */
+  uint64_t rip;
+  /* Cilk worker that recorded the event, or -1 for a thread that is not
+     a Cilk worker.  A trace written by the serial build of the tool
+     records the number of the thread instead, counting threads from 0
+     in the order of their first events. */
+  int16_t worker;
+  /* A trace_event_t */
+  uint16_t type;
+  /* Extra argument of the event: the prop argument of enter_begin and
+     c_function_enter, or in_continuation for spawn_or_continue */
+  uint32_t arg;
+} trace_record_t;
+
+#endif
@@ -11,9 +11,11 @@
 #include <execinfo.h>
 
 #include <cilktool.h>
+#include <reducertool.h>
 
 #include "viewread_stack.h"
 #include "viewread_shadowmem.h"
+#include "viewread_races.h"
 #include "util.h"
 
 #ifndef TRACE_CALLS
@@ -28,6 +30,8 @@ viewread_stack_t ctx_stack;
 
 shadowmem_t *memory;
 
+race_table_t races;
+
 bool TOOL_INITIALIZED = false;
 
 /*************************************************************************/
@@ -39,9 +43,40 @@ void initialize_tool(viewread_stack_t *stack) {
   ensure_serial_tool();
   viewread_stack_init(stack, MAIN);
   memory = shadowmem_create();
+  race_table_init(&races);
   TOOL_INITIALIZED = true;
 }
 
+// Check the read or set call at rip on reducer against the previous
+// access to reducer, and record the call as the latest access.  The
+// call races with the previous access if that access is logically
+// parallel with it, or if a spawn or sync separates them, in which
+// case the two calls may see different views.
+static void check_reducer_access(void *reducer, void *rip,
+                                 const char *function, int line) {
+  viewread_stack_t *stack = &ctx_stack;
+  uint64_t spawns = stack->bot->ancestor_spawns + stack->bot->local_spawns;
+
+  // The shadow memory holds a reference to the node of the latest
+  // access to each reducer.
+  DisjointSet_t *node = viewread_stack_frame_ss_bag(stack->bot);
+  DisjointSet_ref(node);
+
+  // The first access to a reducer cannot race.
+  const reader_t *last_reader = find_reader((reducer_t)reducer, memory);
+  if (NULL != last_reader) {
+    DisjointSet_t *rep = DisjointSet_find_set(last_reader->node);
+    if (P == rep->type || last_reader->spawns != spawns) {
+      record_race(&races, (reducer_t)reducer, (uintptr_t)rip, function, line,
+                  last_reader);
+    }
+    DisjointSet_unref(last_reader->node);
+  }
+
+  update_shadowmem(&memory, (reducer_t)reducer, (uintptr_t)rip,
+                   function, line, spawns, node);
+}
+
 /*************************************************************************/
 /**
  * Main tool methods.
@@ -62,19 +97,28 @@ void cilk_tool_destroy(void) {
   fprintf(stderr, "cilk_tool_destroy()\n");
 #endif
 
+  if (!TOOL_INITIALIZED) {
+    return;
+  }
+  free(memory);
+  memory = NULL;
+  race_table_free(&races);
+  viewread_stack_free(&ctx_stack);
+
   TOOL_INITIALIZED = false;
 }
 
 void cilk_tool_print(void) {
-  /* viewread_stack_t *stack; */
-  /* stack = &ctx_stack; */
-  return;
+  if (!TOOL_INITIALIZED) {
+    return;
+  }
+  print_races(&races, stderr);
 }
 
-void cilk_enter_begin(__cilkrts_stack_frame *sf, void *this_fn, void* rip)
+void cilk_enter_begin(uint32_t prop, __cilkrts_stack_frame *sf, void *this_fn, void* rip)
 {
 #if TRACE_CALLS
-  fprintf(stderr, "cilk_enter_begin(%p, %p, %p)\n", sf, this_fn, rip);
+  fprintf(stderr, "cilk_enter_begin(%u, %p, %p, %p)\n", prop, sf, this_fn, rip);
 #endif
   /* fprintf(stderr, "worker %d entering %p\n", __cilkrts_get_worker_number(), sf); */
   viewread_stack_t *stack;
@@ -144,7 +188,7 @@ void cilk_enter_end(__cilkrts_stack_frame *sf, void *rsp)
   stack->in_user_code = true;
 }
 
-void cilk_tool_c_function_enter(void* this_fn, void *rip) {
+void cilk_tool_c_function_enter(uint32_t prop, void* this_fn, void *rip) {
 /* #if TRACE_CALLS */
 /*   fprintf(stderr, "c_function_enter(%p)\n", rip); */
 /* #endif */
@@ -248,15 +292,8 @@ void cilk_sync_end(__cilkrts_stack_frame *sf)
     /* fprintf(stderr, "P bag %p, SP bag %p\n", */
     /*         stack->bot->p_bag, stack->bot->sp_bag); */
 
-    if (NULL == stack->bot->p_bag && NULL != stack->bot->sp_bag) {
-      stack->bot->p_bag = DisjointSet_find_set(stack->bot->sp_bag);
-      stack->bot->p_bag->type = P;
-      stack->bot->sp_bag = NULL;
-    } else if (NULL != stack->bot->sp_bag) {
-      DisjointSet_combine(stack->bot->p_bag, stack->bot->sp_bag);
-      stack->bot->p_bag->type = P;
-      stack->bot->sp_bag = NULL;
-    }
+    DisjointSet_move_into(&(stack->bot->p_bag), stack->bot->sp_bag, P);
+    DisjointSet_assign(&(stack->bot->sp_bag), NULL);
     assert(!(stack->in_user_code));
     stack->in_user_code = true;
   } else {
@@ -286,14 +323,9 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
 
   /* fprintf(stderr, "returning P bag %p, dest P bag %p\n", */
   /*         old_bottom->p_bag, stack->bot->p_bag); */
-  if (NULL == stack->bot->p_bag && NULL != old_bottom->p_bag) {
-    stack->bot->p_bag = DisjointSet_find_set(old_bottom->p_bag);
-    stack->bot->p_bag->type = P;
-  } else if (NULL != old_bottom->p_bag) {
-    DisjointSet_combine(stack->bot->p_bag, old_bottom->p_bag);
-    stack->bot->p_bag->type = P;
-  }
-  assert(NULL == stack->bot->p_bag || P == stack->bot->p_bag->type);
+  DisjointSet_move_into(&(stack->bot->p_bag), old_bottom->p_bag, P);
+  assert(NULL == stack->bot->p_bag ||
+         P == DisjointSet_find_set(stack->bot->p_bag)->type);
 
   switch(old_bottom->func_type) {
     case CILK:  // Returning from called function
@@ -305,17 +337,10 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
       /*         stack->bot->ss_bag, old_bottom->ss_bag); */
       if (stack->bot->local_spawns == 0) {
         // Combine SS bags
-        DisjointSet_combine(stack->bot->ss_bag, old_bottom->ss_bag);
-        assert(SS == stack->bot->ss_bag->type);
+        DisjointSet_move_into(&(stack->bot->ss_bag), old_bottom->ss_bag, SS);
       } else {
         // Combine returning SS bag into its parent's SP bag
-        if (NULL == stack->bot->sp_bag) {
-          stack->bot->sp_bag = DisjointSet_find_set(old_bottom->ss_bag);
-          stack->bot->sp_bag->type = SP;
-        } else {
-          DisjointSet_combine(stack->bot->sp_bag, old_bottom->ss_bag);
-          stack->bot->sp_bag->type = SP;
-        }          
+        DisjointSet_move_into(&(stack->bot->sp_bag), old_bottom->ss_bag, SP);
       }
       break;
     case HELPER:  // Returning from spawned function
@@ -328,20 +353,16 @@ void cilk_leave_begin(__cilkrts_stack_frame *sf)
 
       assert(0 != stack->bot->local_spawns);
 
-      if (NULL == stack->bot->p_bag) {
-        stack->bot->sp_bag = DisjointSet_find_set(old_bottom->ss_bag);
-        stack->bot->sp_bag->type = P;
-      } else {
-        DisjointSet_combine(stack->bot->p_bag, old_bottom->ss_bag);
-        stack->bot->sp_bag->type = P;
-      }
+      // Combine returning SS bag into its parent's P bag
+      DisjointSet_move_into(&(stack->bot->p_bag), old_bottom->ss_bag, P);
       break;
     case MAIN:
       fprintf(stderr, "[ALERT] cilk_leave_begin(%p) from MAIN.\n", sf);
       break;
   }
 
-  free(old_bottom);
+  // The bags of old_bottom now belong to its parent.
+  viewread_stack_frame_clear(old_bottom);
 }
 
 void cilk_leave_end(void)
@@ -386,31 +407,24 @@ void cilk_set_reducer(void *reducer, void *rip, const char *function, int line)
     initialize_tool(&ctx_stack);
     ctx_stack.in_user_code = true;
   }
-
-  viewread_stack_t *stack = &ctx_stack;
-  update_shadowmem(&memory, (reducer_t)reducer, (uintptr_t)rip,
-                   stack->bot->ancestor_spawns + stack->bot->local_spawns,
-                   stack->bot->ss_bag);
+  check_reducer_access(reducer, rip, function, line);
 }
 
 void cilk_read_reducer(void *reducer, void *rip, const char *function, int line) {
-  viewread_stack_t *stack = &ctx_stack;
-  reader_t *last_reader = get_reader((reducer_t)reducer, &memory);
-  DisjointSet_t *rep = DisjointSet_find_set(last_reader->node);
-  if (P == rep->type ||
-      last_reader->spawns != stack->bot->ancestor_spawns + stack->bot->local_spawns) {
-    fprintf(stderr, "View-read race detected between %p and %p (%s:%d)\n",
-            (void*)(last_reader->reader), rip, function, line);
-  } else {
-    if (P != rep->type) {
-      /* fprintf(stderr, "Safe read; rep %p\n", rep); */
-      assert(stack->bot->ancestor_spawns + stack->bot->local_spawns == last_reader->spawns);
-    } else {
-      /* fprintf(stderr, "spawn counts are both %lx\n", */
-      /*         stack->bot->ancestor_spawns + stack->bot->local_spawns); */
-    }
+  if (!TOOL_INITIALIZED) {
+    initialize_tool(&ctx_stack);
+    ctx_stack.in_user_code = true;
+  }
+  check_reducer_access(reducer, rip, function, line);
+}
+
+void cilk_destroy_reducer(void *reducer, void *rip, const char *function, int line) {
+  if (!TOOL_INITIALIZED) {
+    return;
+  }
+  const reader_t *last_reader = find_reader((reducer_t)reducer, memory);
+  if (NULL != last_reader) {
+    DisjointSet_unref(last_reader->node);
+    remove_reader(memory, (reducer_t)reducer);
   }
-  update_shadowmem(&memory, (reducer_t)reducer, (uintptr_t)rip,
-                   stack->bot->ancestor_spawns + stack->bot->local_spawns,
-                   stack->bot->ss_bag);
 }
@@ -0,0 +1,144 @@
+#ifndef INCLUDED_VIEWREAD_RACES_H
+#define INCLUDED_VIEWREAD_RACES_H
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <assert.h>
+
+#include "viewread_shadowmem.h"
+
+// A view-read race, identified by the reducer and the address of the
+// read or set call that raced.  Repeated races of the same call on the
+// same reducer are counted rather than reported again.
+typedef struct {
+  // ID of reducer, or 0 if this entry is empty
+  reducer_t reducer;
+  // Address, function and line of the read or set call that raced
+  uintptr_t rip;
+  const char *function;
+  int line;
+  // Address, function and line of the previous access to the reducer,
+  // the first time this race was found
+  uintptr_t prev_rip;
+  const char *prev_function;
+  int prev_line;
+  // Number of times the race was found
+  uint64_t count;
+  // Order in which the race was first found
+  int order;
+} race_t;
+
+// Table of view-read races, organized like the shadow memory, as an
+// open-addressed hash table that is at most half full.
+typedef struct {
+  int lg_capacity;
+  int size;
+  race_t *entries;
+} race_table_t;
+
+/**
+ * Method implementations
+ */
+static inline size_t race_hash(reducer_t reducer, uintptr_t rip, int lg_capacity) {
+  return hash(reducer ^ (rip * 0x9e3779b97f4a7c15ULL), lg_capacity);
+}
+
+void race_table_init(race_table_t *tab) {
+  tab->lg_capacity = START_LG_CAPACITY;
+  tab->size = 0;
+  tab->entries = (race_t*)calloc((size_t)1 << tab->lg_capacity, sizeof(race_t));
+}
+
+void race_table_free(race_table_t *tab) {
+  free(tab->entries);
+  tab->entries = NULL;
+  tab->size = 0;
+}
+
+// Helper function to get the entry in entries, of capacity
+// 2^lg_capacity, for the race of the call at rip on reducer.  Returns
+// a pointer to the entry for the race, or to the empty entry where it
+// belongs.
+static race_t* get_race_helper(race_t *entries, int lg_capacity,
+                               reducer_t reducer, uintptr_t rip) {
+  size_t mask = ((size_t)1 << lg_capacity) - 1;
+  size_t i = race_hash(reducer, rip, lg_capacity);
+  while (0 != entries[i].reducer &&
+         !(entries[i].reducer == reducer && entries[i].rip == rip)) {
+    i = (i + 1) & mask;
+  }
+  return &(entries[i]);
+}
+
+// Record a race of the call at rip, function and line on the reducer
+// whose previous access is *prev.
+void record_race(race_table_t *tab, reducer_t reducer,
+                 uintptr_t rip, const char *function, int line,
+                 const reader_t *prev) {
+  if (2 * (tab->size + 1) > (1 << tab->lg_capacity)) {
+    int new_lg_capacity = tab->lg_capacity + 1;
+    race_t *new_entries =
+      (race_t*)calloc((size_t)1 << new_lg_capacity, sizeof(race_t));
+    for (size_t i = 0; i < ((size_t)1 << tab->lg_capacity); ++i) {
+      const race_t *old = &(tab->entries[i]);
+      if (0 == old->reducer) {
+        continue;
+      }
+      *get_race_helper(new_entries, new_lg_capacity, old->reducer, old->rip) = *old;
+    }
+    free(tab->entries);
+    tab->entries = new_entries;
+    tab->lg_capacity = new_lg_capacity;
+  }
+
+  race_t *race = get_race_helper(tab->entries, tab->lg_capacity, reducer, rip);
+  if (0 == race->reducer) {
+    race->reducer = reducer;
+    race->rip = rip;
+    race->function = function;
+    race->line = line;
+    race->prev_rip = prev->reader;
+    race->prev_function = prev->function;
+    race->prev_line = prev->line;
+    race->count = 0;
+    race->order = tab->size++;
+  }
+  ++race->count;
+}
+
+static int compare_race_order(const void *a, const void *b) {
+  return ((const race_t*)a)->order - ((const race_t*)b)->order;
+}
+
+// Print the races in *tab, in the order in which they were first found.
+void print_races(const race_table_t *tab, FILE *out) {
+  if (0 == tab->size) {
+    fprintf(out, "No view-read races detected.\n");
+    return;
+  }
+
+  race_t *races = (race_t*)malloc(tab->size * sizeof(race_t));
+  int num_races = 0;
+  for (size_t i = 0; i < ((size_t)1 << tab->lg_capacity); ++i) {
+    if (0 != tab->entries[i].reducer) {
+      races[num_races++] = tab->entries[i];
+    }
+  }
+  assert(num_races == tab->size);
+  qsort(races, num_races, sizeof(race_t), compare_race_order);
+
+  for (int i = 0; i < num_races; ++i) {
+    const race_t *race = &(races[i]);
+    fprintf(out, "View-read race on reducer %p at %s:%d (%p), "
+            "previous access at %s:%d (%p), found %" PRIu64 " times\n",
+            (void*)race->reducer, race->function, race->line, (void*)race->rip,
+            race->prev_function, race->prev_line, (void*)race->prev_rip,
+            race->count);
+  }
+  fprintf(out, "%d view-read races detected.\n", num_races);
+  free(races);
+}
+
+#endif
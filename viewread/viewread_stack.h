@@ -27,6 +27,12 @@ typedef struct DisjointSet_t {
 
   struct DisjointSet_t *parent;
   uint64_t rank;
+
+  // Number of references to this node: from the nodes whose parent it
+  // is, from the bags of frames, and from shadow memory.  A node with
+  // no references can no longer affect the outcome of any check, so it
+  // returns to the pool.
+  uint64_t refs;
 } DisjointSet_t;
 
 // Typedef of viewread stack frame
@@ -36,12 +42,12 @@ typedef struct viewread_stack_frame_t {
   uint64_t ancestor_spawns;
   uint64_t local_spawns;
 
+  // Bags of the frame.  The SS bag is created when the function first
+  // accesses a reducer, so the bags of most frames stay empty.
   DisjointSet_t* ss_bag;
   DisjointSet_t* sp_bag;
   DisjointSet_t* p_bag;
 
-  struct viewread_stack_frame_t *parent;
-
 } viewread_stack_frame_t;
 
 // Type for a viewread stack
@@ -50,14 +56,91 @@ typedef struct {
      is mostly used for debugging. */
   bool in_user_code;
 
+  /* Array of frames, from the outermost to the bottom of the stack,
+     which grows as needed */
+  viewread_stack_frame_t *frames;
+  size_t capacity;
+  size_t depth;
+
   /* Pointer to bottom of the stack, onto which frames are pushed. */
   viewread_stack_frame_t *bot;
 
 } viewread_stack_t;
 
-void DisjointSet_init(DisjointSet_t *s) {
+/*
+ * Pool of disjoint-set nodes.  Nodes are carved out of slabs, and
+ * released nodes are kept on a free list, linked through their parent
+ * pointers.
+ */
+#define DISJOINT_SET_SLAB_SIZE 1024
+
+typedef struct DisjointSet_slab_t {
+  struct DisjointSet_slab_t *next;
+  DisjointSet_t nodes[DISJOINT_SET_SLAB_SIZE];
+} DisjointSet_slab_t;
+
+static DisjointSet_slab_t *ds_slabs = NULL;
+static size_t ds_slab_used = DISJOINT_SET_SLAB_SIZE;
+static DisjointSet_t *ds_free_list = NULL;
+
+// Returns a new singleton set of type type, with no references.
+DisjointSet_t* DisjointSet_alloc(BagType_t type) {
+  DisjointSet_t *s;
+  if (NULL != ds_free_list) {
+    s = ds_free_list;
+    ds_free_list = s->parent;
+  } else {
+    if (DISJOINT_SET_SLAB_SIZE == ds_slab_used) {
+      DisjointSet_slab_t *slab
+          = (DisjointSet_slab_t*)malloc(sizeof(DisjointSet_slab_t));
+      slab->next = ds_slabs;
+      ds_slabs = slab;
+      ds_slab_used = 0;
+    }
+    s = &(ds_slabs->nodes[ds_slab_used++]);
+  }
   s->parent = s;
   s->rank = 0;
+  s->refs = 0;
+  s->type = type;
+  s->init_func_id = next_func_id++;
+  s->set_func_id = s->init_func_id;
+  return s;
+}
+
+// Frees every node in the pool.
+void DisjointSet_free_all(void) {
+  while (NULL != ds_slabs) {
+    DisjointSet_slab_t *slab = ds_slabs;
+    ds_slabs = slab->next;
+    free(slab);
+  }
+  ds_slab_used = DISJOINT_SET_SLAB_SIZE;
+  ds_free_list = NULL;
+}
+
+static inline void DisjointSet_ref(DisjointSet_t *s) {
+  ++s->refs;
+}
+
+// Drops a reference to s, returning s to the pool if that was its last
+// reference, along with any of its ancestors that become unreferenced.
+void DisjointSet_unref(DisjointSet_t *s) {
+  while (NULL != s && 0 == --s->refs) {
+    DisjointSet_t *parent = (s->parent == s) ? NULL : s->parent;
+    s->parent = ds_free_list;
+    ds_free_list = s;
+    s = parent;
+  }
+}
+
+// Makes the reference *slot refer to s, which may be NULL.
+static inline void DisjointSet_assign(DisjointSet_t **slot, DisjointSet_t *s) {
+  if (NULL != s) {
+    DisjointSet_ref(s);
+  }
+  DisjointSet_unref(*slot);
+  *slot = s;
 }
 
 /*
@@ -74,8 +157,10 @@ void DisjointSet_swap_set_node(DisjointSet_t *s, DisjointSet_t *t) {
 void DisjointSet_link(DisjointSet_t *s, DisjointSet_t *t) {
   if (s->rank > t->rank) {
     t->parent = s;
+    DisjointSet_ref(s);
   } else {
     s->parent = t;
+    DisjointSet_ref(t);
     if (s->rank == t->rank) {
       ++t->rank;
     }
@@ -83,11 +168,22 @@ void DisjointSet_link(DisjointSet_t *s, DisjointSet_t *t) {
   }
 }
 
+// Returns the root of the set containing s, halving the path from s to
+// the root on the way.
 DisjointSet_t* DisjointSet_find_set(DisjointSet_t *s) {
-  if (s->parent != s) {
-    s->parent = DisjointSet_find_set(s->parent);
+  while (s->parent != s) {
+    DisjointSet_t *parent = s->parent;
+    if (parent->parent != parent) {
+      // Point s at its grandparent, which is referenced before the
+      // parent is unreferenced, so releasing the parent cannot
+      // release it.
+      s->parent = parent->parent;
+      DisjointSet_ref(s->parent);
+      DisjointSet_unref(parent);
+    }
+    s = s->parent;
   }
-  return s->parent;
+  return s;
 }
 
 /*
@@ -112,69 +208,111 @@ void DisjointSet_combine(DisjointSet_t *s, DisjointSet_t *t) {
   assert(DisjointSet_find_set(s) == DisjointSet_find_set(t));
 }
 
+// Moves the set containing t, if t is not NULL, into the bag *bag, and
+// gives the bag type type.  The type is stored in the root of the
+// combined set, which may be the root of either set.
+void DisjointSet_move_into(DisjointSet_t **bag, DisjointSet_t *t,
+                           BagType_t type) {
+  if (NULL == t) {
+    return;
+  }
+  if (NULL == *bag) {
+    DisjointSet_assign(bag, DisjointSet_find_set(t));
+  } else {
+    DisjointSet_combine(*bag, t);
+  }
+  DisjointSet_find_set(*bag)->type = type;
+}
+
 
 // Initializes the viewread stack frame *frame
 void viewread_stack_frame_init(viewread_stack_frame_t *frame,
                                FunctionType_t func_type,
                                uint64_t ancestor_spawns)
 {
-  frame->parent = NULL;
   frame->func_type = func_type;
 
   frame->ancestor_spawns = ancestor_spawns;
   frame->local_spawns = 0;
 
-  frame->ss_bag = (DisjointSet_t*)malloc(sizeof(DisjointSet_t));
-  DisjointSet_init(frame->ss_bag);
-  frame->ss_bag->type = SS;
-  frame->ss_bag->init_func_id = next_func_id++;
-  frame->ss_bag->set_func_id = frame->ss_bag->init_func_id;
-
+  frame->ss_bag = NULL;
   frame->sp_bag = NULL;
   frame->p_bag = NULL;
 }
 
 
+// Returns the SS bag of the frame *frame, creating it if necessary.
+DisjointSet_t* viewread_stack_frame_ss_bag(viewread_stack_frame_t *frame)
+{
+  if (NULL == frame->ss_bag) {
+    DisjointSet_assign(&(frame->ss_bag), DisjointSet_alloc(SS));
+  }
+  return frame->ss_bag;
+}
+
+
+// Drops the references from the bags of the frame *frame.
+void viewread_stack_frame_clear(viewread_stack_frame_t *frame)
+{
+  DisjointSet_assign(&(frame->ss_bag), NULL);
+  DisjointSet_assign(&(frame->sp_bag), NULL);
+  DisjointSet_assign(&(frame->p_bag), NULL);
+}
+
+
+// Starting number of frames in the viewread stack
+static const size_t START_STACK_CAPACITY = 64;
+
 // Initializes the viewread stack
 void viewread_stack_init(viewread_stack_t *stack, FunctionType_t func_type)
 {
-  viewread_stack_frame_t *new_frame
-      = (viewread_stack_frame_t *)malloc(sizeof(viewread_stack_frame_t));
-  viewread_stack_frame_init(new_frame, func_type, 0);
-  stack->bot = new_frame;
+  stack->capacity = START_STACK_CAPACITY;
+  stack->frames = (viewread_stack_frame_t *)
+      malloc(stack->capacity * sizeof(viewread_stack_frame_t));
+  stack->depth = 1;
+  stack->bot = &(stack->frames[0]);
+  viewread_stack_frame_init(stack->bot, func_type, 0);
   stack->in_user_code = false;
 }
 
 
+// Frees the frames of the viewread stack and every disjoint-set node.
+void viewread_stack_free(viewread_stack_t *stack)
+{
+  free(stack->frames);
+  stack->frames = NULL;
+  stack->bot = NULL;
+  stack->depth = 0;
+  DisjointSet_free_all();
+}
+
+
 // Push new frame of function type func_type onto the stack *stack
 viewread_stack_frame_t* viewread_stack_push(viewread_stack_t *stack,
                                             FunctionType_t func_type)
 {
-  viewread_stack_frame_t *new_frame
-      = (viewread_stack_frame_t *)malloc(sizeof(viewread_stack_frame_t));
-
   if (HELPER == func_type) {  // Function was spawned
     ++stack->bot->local_spawns;
     
     /* fprintf(stderr, "P bag %p, SP bag %p\n", */
     /*         stack->bot->p_bag, stack->bot->sp_bag); */
 
-    if (NULL == stack->bot->p_bag && NULL != stack->bot->sp_bag) {
-      stack->bot->p_bag = DisjointSet_find_set(stack->bot->sp_bag);
-      stack->bot->p_bag->type = P;
-      stack->bot->sp_bag = NULL;
-    } else if (NULL != stack->bot->sp_bag) {
-      DisjointSet_combine(stack->bot->p_bag, stack->bot->sp_bag);
-      stack->bot->p_bag->type = P;
-      stack->bot->sp_bag = NULL;
-    }
+    DisjointSet_move_into(&(stack->bot->p_bag), stack->bot->sp_bag, P);
+    DisjointSet_assign(&(stack->bot->sp_bag), NULL);
+  }
+
+  if (stack->depth == stack->capacity) {
+    stack->capacity *= 2;
+    stack->frames = (viewread_stack_frame_t *)
+        realloc(stack->frames, stack->capacity * sizeof(viewread_stack_frame_t));
+    stack->bot = &(stack->frames[stack->depth - 1]);
   }
+  viewread_stack_frame_t *new_frame = &(stack->frames[stack->depth++]);
 
   // Initialize the new frame, using the current frame's current view
   // ID as the inital and current view ID of the new frame.
   viewread_stack_frame_init(new_frame, func_type,
                             stack->bot->ancestor_spawns + stack->bot->local_spawns);
-  new_frame->parent = stack->bot;
   stack->bot = new_frame;
 
   return new_frame;
@@ -182,11 +320,13 @@ viewread_stack_frame_t* viewread_stack_push(viewread_stack_t *stack,
 
 
 // Pops the bottommost frame off of the stack *stack, and returns a
-// pointer to it.
+// pointer to it.  The frame remains valid until the next push.
 viewread_stack_frame_t* viewread_stack_pop(viewread_stack_t *stack)
 {
+  assert(stack->depth > 1);
   viewread_stack_frame_t *old_bottom = stack->bot;
-  stack->bot = stack->bot->parent;
+  --stack->depth;
+  stack->bot = &(stack->frames[stack->depth - 1]);
 
   return old_bottom;
 }